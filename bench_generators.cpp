@@ -0,0 +1,330 @@
+// ==========================================================================
+// Scene generator microbenchmark
+//
+// Runs every scene generator over a sweep of levels, with no window and no GL
+// context, and prints the results as JSON so runs can be compared:
+//
+//   g++ -O2 -std=c++11 -pthread bench_generators.cpp generators.cpp escapetime.cpp tilepool.cpp deepzoom.cpp tilestore.cpp buddhabrot.cpp -o bench_generators
+//   ./bench_generators [--scene N] [--size WIDTHxHEIGHT] [--repeat N] [--threads N] [--subdivide] > run.json
+//   ./bench_generators --scaling [MAX_THREADS] [--scene N] [--size WIDTHxHEIGHT] > scaling.json
+//   ./bench_generators --views [--size WIDTHxHEIGHT] [--repeat N] > views.json
+//
+// For every (scene, level) it reports the median and best time per call, ns per
+// vertex, vertices per second, the registry's vertex estimate, the peak capacity
+// of the output vectors, the number of heap allocations made during one call and
+// how many escape-time iterations the interior checks skipped.
+// --scaling instead runs the image scenes at their highest level
+// with 1, 2, 4, ... threads up to MAX_THREADS (one per core by default) and
+// reports the speedup and parallel efficiency over one thread. Runs with more
+// threads than cores are marked oversubscribed, since they can't show scaling.
+// --views makes the Mandelbrot set at some well known views with and without
+// --subdivide, and reports how much faster subdividing was and how many texels
+// came out different (which should always be none).
+//
+// Modifications and additional functionality by Cameron Hardy (ID 10084560)
+// ==========================================================================
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <string>
+#include <vector>
+#include "glm/glm.hpp"
+#include "generators.h"
+#include "escapetime.h"
+#include "tilepool.h"
+#include "deepzoom.h"
+
+using namespace std;
+using namespace glm;
+
+// every allocation goes through here so we can count how many a generator makes
+// (from every thread it uses)
+static atomic<size_t> allocations(0);
+
+void* operator new(size_t size)
+{
+    allocations++;
+    void* p = malloc(size ? size : 1);
+    if(!p)
+        throw bad_alloc();
+    return p;
+}
+
+void operator delete(void* p) noexcept
+{
+    free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+    free(p);
+}
+
+// levels to run each scene at, ending with 0. The output names each sweep
+// after its scene in the registry
+struct Sweep {
+    int scene;
+    int levels[8];
+};
+
+const Sweep sweeps[] = {
+    {1,  {1, 10, 100, 1000, 10000, 0}},
+    {2,  {1, 10, 100, 1000, 0}},
+    {3,  {1, 4, 7, 10, 0}},
+    {4,  {1, 5, 20, 100, 0}},
+    {5,  {4, 8, 12, 17, 0}},
+    {6,  {10, 50, 100, 500, 0}},
+    {7,  {10, 50, 100, 500, 0}},
+    {8,  {10, 50, 100, 500, 0}},
+    {9,  {10, 50, 100, 0}},
+    {10, {10, 50, 100, 500, 0}},
+    {11, {10, 50, 100, 500, 0}},
+    {12, {10, 50, 100, 500, 0}},
+};
+
+const int sweepCount = sizeof(sweeps)/sizeof(sweeps[0]);
+
+struct Result {
+    long vertices;
+    double medianNs;
+    double bestNs;
+    size_t peakCapacity;                    // bytes reserved by points + colors
+    size_t allocations;
+    long long skipped;                      // iterations the escape-time interior checks saved
+};
+
+Result measure(int scene, int level, int width, int height, int repeat)
+{
+    Result result;
+    vector<double> times;
+
+    for(int r=0; r<repeat; r++) {
+        // fresh vectors every time, just like the window's worker gets
+        vector<vec2> points;
+        vector<vec3> colors;
+        srand(1);
+
+        allocations = 0;
+        long long skipped = escapeSkippedIterations();
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        generateScene(scene, level, width, height, points, colors);
+        chrono::steady_clock::time_point end = chrono::steady_clock::now();
+
+        times.push_back(chrono::duration<double, nano>(end - start).count());
+        result.allocations = allocations.load();
+        result.skipped = escapeSkippedIterations() - skipped;
+        result.vertices = points.size();
+        result.peakCapacity = sizeof(vec2)*points.capacity() + sizeof(vec3)*colors.capacity();
+    }
+
+    sort(times.begin(), times.end());
+    result.medianNs = times[times.size()/2];
+    result.bestNs = times[0];
+    return result;
+}
+
+// the tile pool only splits up the image scenes, so those are the ones to scale
+int runScaling(int only, int width, int height, int repeat, int maxThreads)
+{
+    printf("{\n  \"width\": %d,\n  \"height\": %d,\n  \"repeat\": %d,\n  \"kernel\": \"%s\",\n  \"cores\": %d,\n  \"scaling\": [",
+           width, height, repeat, escapeKernelName(), tileThreads(0));
+
+    // past one thread per core the threads just take turns, so those runs say
+    // nothing about how it scales and are marked as such
+    int cores = tileThreads(0);
+    bool first = true;
+    for(int s=0; s<sweepCount; s++) {
+        const Sweep& sweep = sweeps[s];
+        if(!findScene(sweep.scene)->image)
+            continue;
+        if(only && sweep.scene != only)
+            continue;
+
+        int level = sweep.levels[0];
+        for(int l=0; sweep.levels[l] > 0; l++)
+            level = sweep.levels[l];
+
+        double single = 0.0;
+        for(int threads=1; ; threads = std::min(threads*2, maxThreads)) {
+            cerr << findScene(sweep.scene)->name << " level " << level << " on " << threads << " threads..." << endl;
+            generatorThreads = threads;
+            Result r = measure(sweep.scene, level, width, height, repeat);
+            if(threads == 1)
+                single = r.medianNs;
+
+            double speedup = r.medianNs > 0.0 ? single/r.medianNs : 0.0;
+            printf("%s\n    {\"scene\": %d, \"name\": \"%s\", \"level\": %d, \"threads\": %d, "
+                   "\"median_ns\": %.0f, \"best_ns\": %.0f, \"speedup\": %.3f, \"efficiency\": %.3f, "
+                   "\"allocations\": %zu, \"oversubscribed\": %s}",
+                   first ? "" : ",", sweep.scene, findScene(sweep.scene)->name, level, threads,
+                   r.medianNs, r.bestNs, speedup, speedup/threads, r.allocations, threads > cores ? "true" : "false");
+            first = false;
+            fflush(stdout);
+
+            if(threads >= maxThreads)
+                break;
+        }
+    }
+
+    printf("\n  ]\n}\n");
+    return 0;
+}
+
+// places in the Mandelbrot set to try subdividing on, from the whole set to
+// thin filaments where there's hardly anything to fill in
+struct View {
+    const char* name;
+    double x;                               // the middle of the window
+    double y;
+    double zoom;
+    int level;
+};
+
+const View views[] = {
+    {"whole",          -0.75,    0.0,    1.0,    500},
+    {"whole deep",     -0.75,    0.0,    1.0,    2100},
+    {"seahorse",       -0.745,   0.11,   40.0,   1000},
+    {"elephant",       0.28,     0.008,  60.0,   1000},
+    {"minibrot",       -1.7687,  0.0017, 300.0,  2000},
+    {"spiral",         -0.7436,  0.1318, 3000.0, 3000},
+    {"tendril",        -0.1011,  0.9563, 200.0,  1500},
+    {"needle",         -1.9,     0.0,    20.0,   1000},
+    {"valley",         -0.16,    1.0405, 400.0,  2000},
+    {"dendrite",       -0.7269,  0.1889, 1000.0, 2500},
+};
+
+const int viewCount = sizeof(views)/sizeof(views[0]);
+
+// best time in ns to make the view from scratch, leaving the last image in `image`
+double measureView(const EscapeView& view, int level, int width, int height, int repeat, EscapeImage& image)
+{
+    double best = 0.0;
+    for(int r=0; r<repeat; r++) {
+        image = EscapeImage();
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        imageFormula<ESCAPE::MANDELBROT>(level, width, height, view, 1, image);
+        chrono::steady_clock::time_point end = chrono::steady_clock::now();
+        
+        double ns = chrono::duration<double, nano>(end - start).count();
+        if(r == 0 || ns < best)
+            best = ns;
+    }
+    return best;
+}
+
+int runViews(int width, int height, int repeat)
+{
+    printf("{\n  \"width\": %d,\n  \"height\": %d,\n  \"repeat\": %d,\n  \"kernel\": \"%s\",\n  \"threads\": %d,\n  \"views\": [",
+           width, height, repeat, escapeKernelName(), tileThreads(generatorThreads));
+    
+    for(int v=0; v<viewCount; v++) {
+        // texel (j, i) is at (3.5/width/zoom)*(j + 1) - 2.5 + x, so put the middle texel on the point
+        EscapeView view;
+        view.zoom = views[v].zoom;
+        view.x = deepFromDouble(views[v].x + 2.5 - (3.5/width/view.zoom)*(width/2 + 1));
+        view.y = deepFromDouble(views[v].y + 1.5 - (3.0/height/view.zoom)*(height/2 + 1));
+        cerr << views[v].name << " at level " << views[v].level << "..." << endl;
+        
+        EscapeImage brute;
+        EscapeImage subdivided;
+        escapeSubdivide = false;
+        long long bruteSkipped = escapeSkippedIterations();
+        double bruteNs = measureView(view, views[v].level, width, height, repeat, brute);
+        bruteSkipped = (escapeSkippedIterations() - bruteSkipped)/repeat;
+        escapeSubdivide = true;
+        long long subdivideSkipped = escapeSkippedIterations();
+        double subdivideNs = measureView(view, views[v].level, width, height, repeat, subdivided);
+        subdivideSkipped = (escapeSkippedIterations() - subdivideSkipped)/repeat;
+        
+        long different = 0;
+        for(size_t t=0; t<brute.levels.size(); t++)
+            different += brute.levels[t] != subdivided.levels[t];
+        
+        printf("%s\n    {\"view\": \"%s\", \"x\": %.6f, \"y\": %.6f, \"zoom\": %g, \"level\": %d, "
+               "\"brute_ns\": %.0f, \"subdivide_ns\": %.0f, \"speedup\": %.3f, "
+               "\"brute_iterations_skipped\": %lld, \"subdivide_iterations_skipped\": %lld, \"texels_different\": %ld}",
+               v ? "," : "", views[v].name, views[v].x, views[v].y, views[v].zoom, views[v].level,
+               bruteNs, subdivideNs, subdivideNs > 0.0 ? bruteNs/subdivideNs : 0.0, bruteSkipped, subdivideSkipped, different);
+        fflush(stdout);
+    }
+    escapeSubdivide = false;
+    
+    printf("\n  ]\n}\n");
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    int only = 0;
+    int width = 700;
+    int height = 700;
+    int repeat = 5;
+    int scaling = -1;                       // max threads to scale up to, -1 for the normal sweep
+    bool compareViews = false;
+
+    for(int i=1; i<argc; i++) {
+        string arg = argv[i];
+        if(arg == "--scene" && i+1 < argc)
+            only = atoi(argv[++i]);
+        else if(arg == "--size" && i+1 < argc && sscanf(argv[i+1], "%dx%d", &width, &height) == 2)
+            i++;
+        else if(arg == "--repeat" && i+1 < argc)
+            repeat = std::max(1, atoi(argv[++i]));
+        else if(arg == "--threads" && i+1 < argc)
+            generatorThreads = atoi(argv[++i]);
+        else if(arg == "--subdivide")
+            escapeSubdivide = true;
+        else if(arg == "--views")
+            compareViews = true;
+        else if(arg == "--scaling") {
+            scaling = 0;
+            if(i+1 < argc && argv[i+1][0] != '-')
+                scaling = atoi(argv[++i]);
+        }
+        else {
+            cerr << "usage: " << argv[0] << " [--scene N] [--size WIDTHxHEIGHT] [--repeat N] [--threads N] [--subdivide] [--scaling [MAX_THREADS]] [--views]" << endl;
+            return -1;
+        }
+    }
+
+    if(scaling >= 0)
+        return runScaling(only, width, height, repeat, tileThreads(scaling));
+    if(compareViews)
+        return runViews(width, height, repeat);
+
+    printf("{\n  \"width\": %d,\n  \"height\": %d,\n  \"repeat\": %d,\n  \"kernel\": \"%s\",\n  \"kernel_lanes\": %d,\n  \"threads\": %d,\n  \"subdivide\": %s,\n  \"results\": [",
+           width, height, repeat, escapeKernelName(), escapeKernelLanes(), tileThreads(generatorThreads),
+           escapeSubdivide ? "true" : "false");
+
+    bool first = true;
+    for(int s=0; s<sweepCount; s++) {
+        const Sweep& sweep = sweeps[s];
+        if(only && sweep.scene != only)
+            continue;
+
+        for(int l=0; sweep.levels[l] > 0; l++) {
+            int level = sweep.levels[l];
+            cerr << findScene(sweep.scene)->name << " level " << level << "..." << endl;
+            Result r = measure(sweep.scene, level, width, height, repeat);
+
+            double nsPerVertex = r.vertices > 0 ? r.medianNs/r.vertices : 0.0;
+            double verticesPerSecond = r.medianNs > 0.0 ? r.vertices/(r.medianNs*1.0e-9) : 0.0;
+            printf("%s\n    {\"scene\": %d, \"name\": \"%s\", \"level\": %d, \"vertices\": %ld, \"estimated_vertices\": %.0f, "
+                   "\"median_ns\": %.0f, \"best_ns\": %.0f, \"ns_per_vertex\": %.3f, \"vertices_per_second\": %.0f, "
+                   "\"peak_capacity_bytes\": %zu, \"allocations\": %zu, \"iterations_skipped\": %lld}",
+                   first ? "" : ",", sweep.scene, findScene(sweep.scene)->name, level, r.vertices,
+                   estimateVertices(sweep.scene, level, width, height),
+                   r.medianNs, r.bestNs, nsPerVertex, verticesPerSecond, r.peakCapacity, r.allocations, r.skipped);
+            first = false;
+            fflush(stdout);
+        }
+    }
+
+    printf("\n  ]\n}\n");
+    return 0;
+}
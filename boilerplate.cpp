@@ -18,7 +18,22 @@
 #include <iterator>
 #include <algorithm>
 #include <vector>
+#include <list>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstddef>
+#include <cstring>
+#include <cmath>
 #include "glm/glm.hpp"
+#include "glm/gtc/packing.hpp"
+#include "generators.h"
+#include "escapetime.h"
+#include "rasterizer.h"
+#include "tilestore.h"
 
 // specify that we want the OpenGL core profile before including GLFW headers
 #define GLFW_INCLUDE_GLCOREARB
@@ -41,6 +56,8 @@ int scene = 1;
 int level = 1;
 int width = 700;
 int height = 700;
+EscapeView view;                            // where the Mandelbrot and Julia sets are panned and zoomed to
+string sceneStatus;                         // what's on screen, for the title bar
 // reports GLFW errors
 void ErrorCallback(int error, const char* description)
 {
@@ -48,38 +65,117 @@ void ErrorCallback(int error, const char* description)
     cout << description << endl;
 }
 
+// press C on the Julia set to have its c follow the cursor, and again to leave
+// it where it is. The window stands for the whole Mandelbrot set, so the Julia
+// set shown is the one for the point of the Mandelbrot set under the cursor
+bool steering = false;
+
+void steerJulia(GLFWwindow* window, double x, double y)
+{
+    int w, h;
+    glfwGetWindowSize(window, &w, &h);
+    view.juliaX = 3.5*x/std::max(w, 1) - 2.5;
+    view.juliaY = 1.5 - 3.0*y/std::max(h, 1);
+}
+
 // handles keyboard input events
 void KeyCallback(GLFWwindow* window, int key, int scancode, int action, int mods)
 {
     if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS)
         glfwSetWindowShouldClose(window, GL_TRUE);
     
-    // use number keys 1-5 to select a scene
+    // use number keys to select a scene from the registry
     // alternatively use left and right arrow keys
     
     // use up and down key to increase/decrease number of drawn levels
-    if (key == GLFW_KEY_1 && action == GLFW_PRESS)
-        scene = 1;
-    if (key == GLFW_KEY_2 && action == GLFW_PRESS)
-        scene = 2;
-    if (key == GLFW_KEY_3 && action == GLFW_PRESS)
-        scene = 3;
-    if (key == GLFW_KEY_4 && action == GLFW_PRESS)
-        scene = 4;
-    if (key == GLFW_KEY_5 && action == GLFW_PRESS)
-        scene = 5;
-    if (key == GLFW_KEY_6 && action == GLFW_PRESS)
-        scene = 6;
-    if (key == GLFW_KEY_7 && action == GLFW_PRESS)
-        scene = 7;
+    int previous = scene;
+    if (key >= GLFW_KEY_1 && key <= GLFW_KEY_9 && action == GLFW_PRESS && key - GLFW_KEY_0 <= sceneCount)
+        scene = key - GLFW_KEY_0;
     if (key == GLFW_KEY_UP && action == GLFW_PRESS)
         level++;
     if (key == GLFW_KEY_DOWN && action == GLFW_PRESS && level > 0)
         level--;
+    // deep zooms need thousands of levels, so these get there quicker
+    if (key == GLFW_KEY_PAGE_UP && action == GLFW_PRESS && level < 1 << 24)
+        level = std::max(1, level*2);
+    if (key == GLFW_KEY_PAGE_DOWN && action == GLFW_PRESS)
+        level /= 2;
     if (key == GLFW_KEY_LEFT && action == GLFW_PRESS && scene > 1)
         scene--;
-    if (key == GLFW_KEY_RIGHT && action == GLFW_PRESS && scene < 7)
+    if (key == GLFW_KEY_RIGHT && action == GLFW_PRESS && scene < sceneCount)
         scene++;
+    
+    // every scene starts out showing all of itself, and R goes back to that
+    if (scene != previous || (key == GLFW_KEY_R && action == GLFW_PRESS))
+        view = EscapeView();
+    if (scene != previous)
+        steering = false;
+    
+    if (key == GLFW_KEY_C && action == GLFW_PRESS && findScene(scene)->image == imageFormula<ESCAPE::JULIA>) {
+        steering = !steering;
+        if (steering) {
+            double x, y;
+            glfwGetCursorPos(window, &x, &y);
+            steerJulia(window, x, y);
+        }
+    }
+}
+
+// drag with the left button to pan the Mandelbrot and Julia sets and scroll to zoom them
+bool dragging = false;
+double dragX;                               // where the cursor was when the drag started
+double dragY;
+EscapeView dragView;                        // and what the view was
+
+void MouseButtonCallback(GLFWwindow* window, int button, int action, int mods)
+{
+    if (button != GLFW_MOUSE_BUTTON_LEFT)
+        return;
+    dragging = action == GLFW_PRESS;
+    glfwGetCursorPos(window, &dragX, &dragY);
+    dragView = view;
+}
+
+void CursorPosCallback(GLFWwindow* window, double x, double y)
+{
+    if (!findScene(scene)->image)
+        return;
+    
+    // the cursor moves in window coordinates, the view pans by whole framebuffer
+    // pixels so the ones that stay on screen can be reused
+    if (dragging) {
+        int w, h;
+        glfwGetWindowSize(window, &w, &h);
+        view = dragView;
+        view.panX -= (int)floor((x - dragX)*width/std::max(w, 1) + 0.5);
+        view.panY += (int)floor((y - dragY)*height/std::max(h, 1) + 0.5);
+    }
+    if (steering)
+        steerJulia(window, x, y);
+}
+
+void ScrollCallback(GLFWwindow* window, double xoffset, double yoffset)
+{
+    if (!findScene(scene)->image)
+        return;
+    
+    // a notch zooms in or out by a quarter, keeping what's under the cursor where it is
+    double x, y;
+    int w, h;
+    glfwGetCursorPos(window, &x, &y);
+    glfwGetWindowSize(window, &w, &h);
+    view = zoomView(view, width, height, x*width/std::max(w, 1), (h - y)*height/std::max(h, 1), pow(1.25, yoffset));
+    dragView = view;
+    dragX = x;
+    dragY = y;
+}
+
+// keeps the generated geometry matched to the size of the framebuffer
+void FramebufferSizeCallback(GLFWwindow* window, int w, int h)
+{
+    width = w;
+    height = h;
+    glViewport(0, 0, width, height);
 }
 
 
@@ -88,61 +184,328 @@ void KeyCallback(GLFWwindow* window, int key, int scancode, int action, int mods
 //==========================================================================
 
 
-// vec2 and vec3 are part of the glm math library.
-// Include in your own project by putting the glm directory in your project,
-// and including glm/glm.hpp as I have at the top of the file.
-// "using namespace glm;" will allow you to avoid writing everyting as glm::vec2
-vector<vec2> points;
-vector<vec3> colors;
+// --------------------------------------------------------------------------
+// Frame profiler
 
-// Structs are simply acting as namespaces
-// Access the values like so: VAO::LINES
-struct VAO{
-    enum {LINES=0, COUNT};                  // Enumeration assigns each name a value going up
-    //LINES=0, COUNT=1
+// Times the generate, upload, draw and swap stage of every frame along with how
+// much geometry went through it. Samples go into a fixed-size ring so recording
+// never allocates; the rolling percentiles are shown in the window title and
+// the ring is written out as CSV on exit. Turned on with --profile [file.csv].
+struct STAGE{
+    enum {GENERATE=0, UPLOAD, DRAW, SWAP, COUNT};
+};
+
+const char* stageNames[STAGE::COUNT] = {"generate", "upload", "draw", "swap"};
+
+struct FrameSample {
+    long frame;
+    double ms[STAGE::COUNT];                // negative if the stage didn't run this frame
+    long vertices;                          // vertices drawn
+    long generated;                         // vertices generated by the worker
+    long long skipped;                      // escape-time iterations the interior checks saved it
+    long long antialiased;                  // extra samples --antialias took for it
+    long bytes;                             // bytes uploaded to the GPU
 };
 
+const int PROFILE_FRAMES = 4096;            // how many frames the ring remembers
+const int PROFILE_QUERIES = 4;              // draw timer queries allowed in flight
+
+bool profiling = false;
+string profilePath = "profile.csv";
+
+FrameSample frameSamples[PROFILE_FRAMES];
+long frameCount = 0;                        // number of frames recorded so far
+FrameSample* currentFrame = &frameSamples[0];
+
+// GL timer queries measure how long the GPU spent drawing; their results come
+// back a frame or two later and are filled into the sample they were issued for
+bool timerQueries = false;
+GLuint drawQuery[PROFILE_QUERIES];
+long drawQueryFrame[PROFILE_QUERIES];       // frame each query belongs to, -1 when idle
+
+double profileTime()
+{
+    return chrono::duration<double, milli>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// adds the time since start (in ms) to a stage of the current frame
+void profileStage(int stage, double start)
+{
+    double& ms = currentFrame->ms[stage];
+    ms = std::max(ms, 0.0) + (profileTime() - start);
+}
+
+void initProfiler()
+{
+    if(!profiling)
+        return;
+    
+    // GL_TIME_ELAPSED queries are core since OpenGL 3.3
+    GLint major = 0;
+    GLint minor = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &major);
+    glGetIntegerv(GL_MINOR_VERSION, &minor);
+    timerQueries = major > 3 || (major == 3 && minor >= 3) || glfwExtensionSupported("GL_ARB_timer_query");
+    
+    if(timerQueries)
+        glGenQueries(PROFILE_QUERIES, drawQuery);
+    for(int i=0; i<PROFILE_QUERIES; i++)
+        drawQueryFrame[i] = -1;
+}
+
+// collects any timer queries the GPU has finished with
+void resolveDrawQueries()
+{
+    for(int i=0; i<PROFILE_QUERIES; i++) {
+        if(drawQueryFrame[i] < 0)
+            continue;
+        
+        GLint available = 0;
+        glGetQueryObjectiv(drawQuery[i], GL_QUERY_RESULT_AVAILABLE, &available);
+        if(!available)
+            continue;
+        
+        GLuint64 ns = 0;
+        glGetQueryObjectui64v(drawQuery[i], GL_QUERY_RESULT, &ns);
+        
+        // the frame might have dropped out of the ring while we were waiting
+        FrameSample& sample = frameSamples[drawQueryFrame[i] % PROFILE_FRAMES];
+        if(sample.frame == drawQueryFrame[i])
+            sample.ms[STAGE::DRAW] = ns/1.0e6;
+        drawQueryFrame[i] = -1;
+    }
+}
+
+void beginFrame()
+{
+    if(!profiling)
+        return;
+    if(timerQueries)
+        resolveDrawQueries();
+    
+    currentFrame = &frameSamples[frameCount % PROFILE_FRAMES];
+    currentFrame->frame = frameCount;
+    for(int i=0; i<STAGE::COUNT; i++)
+        currentFrame->ms[i] = -1.0;
+    currentFrame->vertices = 0;
+    currentFrame->generated = 0;
+    currentFrame->skipped = 0;
+    currentFrame->antialiased = 0;
+    currentFrame->bytes = 0;
+}
+
+// wraps glDrawArrays with a timer query when we have one free, otherwise times the call on the CPU
+void profiledDraw(GLenum mode, GLsizei count)
+{
+    if(!profiling) {
+        glDrawArrays(mode, 0, count);
+        return;
+    }
+    
+    int query = -1;
+    for(int i=0; timerQueries && i<PROFILE_QUERIES; i++) {
+        if(drawQueryFrame[i] < 0) {
+            query = i;
+            break;
+        }
+    }
+    
+    currentFrame->vertices += count;
+    if(query < 0) {
+        double start = profileTime();
+        glDrawArrays(mode, 0, count);
+        profileStage(STAGE::DRAW, start);
+        return;
+    }
+    
+    glBeginQuery(GL_TIME_ELAPSED, drawQuery[query]);
+    glDrawArrays(mode, 0, count);
+    glEndQuery(GL_TIME_ELAPSED);
+    drawQueryFrame[query] = frameCount;
+}
+
+// value at percentile p (0-100) of one stage over the frames in the ring that ran it
+double stagePercentile(int stage, double p)
+{
+    static double sorted[PROFILE_FRAMES];   // scratch space, so we don't allocate every frame
+    long frames = std::min(frameCount, (long)PROFILE_FRAMES);
+    int n = 0;
+    for(long i=0; i<frames; i++) {
+        if(frameSamples[i].ms[stage] >= 0.0)
+            sorted[n++] = frameSamples[i].ms[stage];
+    }
+    if(n == 0)
+        return 0.0;
+    
+    int k = std::min(n-1, (int)(p/100.0*n));
+    nth_element(sorted, sorted + k, sorted + n);
+    return sorted[k];
+}
+
+string shownStatus;
+long long lastSkipped = 0;                  // iterations skipped by the last generate that was shown
+long long lastAntialiased = 0;              // and extra samples it took to antialias
+
+void endFrame(GLFWwindow* window)
+{
+    if(!profiling) {
+        // without the profiler the title only changes along with the scene
+        if(sceneStatus != shownStatus) {
+            shownStatus = sceneStatus;
+            glfwSetWindowTitle(window, ("CPSC 453 OpenGL Boilerplate | " + sceneStatus).c_str());
+        }
+        return;
+    }
+    frameCount++;
+    
+    // rolling p50/p95/p99 per stage, formatted on the stack
+    char title[512];
+    int length = snprintf(title, sizeof(title), "CPSC 453 | %s | p50/p95/p99 ms", sceneStatus.c_str());
+    for(int i=0; i<STAGE::COUNT && length < (int)sizeof(title); i++) {
+        length += snprintf(title + length, sizeof(title) - length, " | %s %.2f/%.2f/%.2f", stageNames[i],
+                           stagePercentile(i, 50), stagePercentile(i, 95), stagePercentile(i, 99));
+    }
+    if(lastSkipped > 0 && length < (int)sizeof(title))
+        length += snprintf(title + length, sizeof(title) - length, " | skipped %.1fM iterations", lastSkipped/1.0e6);
+    if(lastAntialiased > 0 && length < (int)sizeof(title))
+        snprintf(title + length, sizeof(title) - length, " | antialiased with %.1fM samples", lastAntialiased/1.0e6);
+    glfwSetWindowTitle(window, title);
+}
+
+// writes whatever is still in the ring out as CSV, oldest frame first
+void dumpProfile()
+{
+    if(!profiling)
+        return;
+    
+    ofstream output(profilePath.c_str());
+    if(!output) {
+        cout << "ERROR: Could not write profile to file " << profilePath << endl;
+        return;
+    }
+    
+    output << "frame";
+    for(int i=0; i<STAGE::COUNT; i++)
+        output << "," << stageNames[i] << "_ms";
+    output << ",vertices,generated,iterations_skipped,antialias_samples,bytes_uploaded" << endl;
+    
+    long first = std::max(0L, frameCount - PROFILE_FRAMES);
+    for(long f=first; f<frameCount; f++) {
+        const FrameSample& sample = frameSamples[f % PROFILE_FRAMES];
+        output << sample.frame;
+        for(int i=0; i<STAGE::COUNT; i++) {
+            output << ",";
+            if(sample.ms[i] >= 0.0)
+                output << sample.ms[i];
+        }
+        output << "," << sample.vertices << "," << sample.generated << "," << sample.skipped << "," << sample.antialiased << "," << sample.bytes << endl;
+    }
+    
+    cout << "Wrote " << frameCount - first << " frames of profile data to " << profilePath << endl;
+    for(int i=0; i<STAGE::COUNT; i++) {
+        cout << "  " << stageNames[i] << " p50 " << stagePercentile(i, 50) << " ms, p95 "
+             << stagePercentile(i, 95) << " ms, p99 " << stagePercentile(i, 99) << " ms" << endl;
+    }
+    
+    if(timerQueries)
+        glDeleteQueries(PROFILE_QUERIES, drawQuery);
+}
+
+// what glDrawArrays calls each of the scene generators' primitive types
+const GLenum glPrimitive[PRIMITIVE::COUNT] = {GL_LINES, GL_LINE_STRIP, GL_TRIANGLES, GL_POINTS};
+
+// Structs are simply acting as namespaces
+// Access the values like so: VBO::POINTS
 struct VBO{
     enum {POINTS=0, COLOR, COUNT};          // POINTS=0, COLOR=1, COUNT=2
 };
 
 struct SHADER{
-    enum {LINE=0, COUNT};                   // LINE=0, COUNT=1
+    enum {LINE=0, IMAGE, COUNT};            // LINE=0, IMAGE=1, COUNT=2
 };
 
-GLuint vbo [VBO::COUNT];                    // Array which stores OpenGL's vertex buffer object handles
-GLuint vao [VAO::COUNT];                    // Array which stores Vertex Array Object handles
 GLuint shader [SHADER::COUNT];              // Array which stores shader program handles
 
+// --compact stores each vertex in 8 bytes instead of 20: the position as two
+// snorm16s and the color as four unorm8s, interleaved in the VBO::POINTS buffer
+// (VBO::COLOR goes unused). The scenes all fit in [-1, 1] so nothing gets
+// clamped, and 1/32767 is a tiny fraction of a pixel.
+struct PackedVertex {
+    uint position;                          // packPosition
+    uint color;                             // packUnorm4x8
+};
+
+bool compactVertices = false;
+
+// bytes of GPU memory a vertex takes up in the current layout
+size_t vertexBytes()
+{
+    return compactVertices ? sizeof(PackedVertex) : sizeof(vec2) + sizeof(vec3);
+}
+
+// like packSnorm2x16, but rounds down instead of to nearest. The Mandelbrot and
+// Julia scenes put every point right on a pixel corner and GL gives those to
+// the pixel below and to the left, so rounding down keeps each point in the
+// same pixel it lands in as a float (rounding to nearest leaves gaps)
+uint packPosition(vec2 position)
+{
+    vec2 snorm = floor(clamp(position, -1.0f, 1.0f)*32767.0f);
+    return uint(ushort(short(snorm.x))) | uint(ushort(short(snorm.y))) << 16;
+}
+
+// packs vertices [first, end) of points/colors into packed
+void packVertices(const vector<vec2>& points, const vector<vec3>& colors, size_t first, size_t end, vector<PackedVertex>& packed)
+{
+    packed.resize(end - first);
+    for(size_t i=0; i<packed.size(); i++) {
+        packed[i].position = packPosition(points[first+i]);
+        packed[i].color = packUnorm4x8(vec4(colors[first+i], 1.0f));
+    }
+}
+
 
 // Gets handles from OpenGL
-void generateIDs()
+// every cached scene owns one Vertex Array Object and VBO::COUNT buffers
+void generateIDs(GLuint& vao, GLuint vbo[VBO::COUNT])
 {
-    glGenVertexArrays(VAO::COUNT, vao);		// Tells OpenGL to create VAO::COUNT many
-                                            // Vertex Array Objects, and store their
-                                            // handles in vao array
+    glGenVertexArrays(1, &vao);             // Tells OpenGL to create a Vertex Array Object
+                                            // and store its handle in vao
     glGenBuffers(VBO::COUNT, vbo);          // Tells OpenGL to create VBO::COUNT many
                                             // Vertex Buffer Objects and store their
                                             // handles in vbo array
 }
 
 // Clean up IDs when you're done using them
-void deleteIDs()
+void deleteIDs(GLuint& vao, GLuint vbo[VBO::COUNT])
+{
+    glDeleteVertexArrays(1, &vao);
+    glDeleteBuffers(VBO::COUNT, vbo);
+}
+
+void deleteShaders()
 {
     for(int i=0; i<SHADER::COUNT; i++)
     {
         glDeleteProgram(shader[i]);
     }
-    
-    glDeleteVertexArrays(VAO::COUNT, vao);
-    glDeleteBuffers(VBO::COUNT, vbo);
 }
 
 
 // Describe the setup of the Vertex Array Object
-bool initVAO()
+bool initVAO(GLuint vao, const GLuint vbo[VBO::COUNT])
 {
-    glBindVertexArray(vao[VAO::LINES]);                 //Set the active Vertex Array
+    glBindVertexArray(vao);                             //Set the active Vertex Array
+    
+    if(compactVertices) {
+        // both attributes come out of one buffer and get normalized back to floats,
+        // so the shaders don't know the difference
+        glBindBuffer(GL_ARRAY_BUFFER, vbo[VBO::POINTS]);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 2, GL_SHORT, GL_TRUE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, position));
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, color));
+        return !CheckGLErrors();
+    }
     
     glEnableVertexAttribArray(0);                       // Tell opengl you're using layout attribute 0 (For shader input)
     glBindBuffer( GL_ARRAY_BUFFER, vbo[VBO::POINTS] );	// Set the active Vertex Buffer
@@ -170,29 +533,135 @@ bool initVAO()
 }
 
 
-//Loads buffers with data
-bool loadBuffer(const vector<vec2>& points, const vector<vec3>& colors)
+// --------------------------------------------------------------------------
+// Streaming uploads
+
+// How vertices get into the VBOs, picked with --upload at startup:
+//   grow        buffers only ever grow (doubling when they're full), and new
+//               vertices go in with glBufferSubData
+//   orphan      every upload calls glBufferData(0) first, so the driver can hand
+//               back fresh memory instead of waiting on draws still reading the
+//               old store, then everything is sent again with glBufferSubData
+//   persistent  a ring of staging slots mapped once with glBufferStorage. The
+//               worker copies finished vertices straight into it while the GL
+//               thread keeps drawing, and the GL thread only has to issue
+//               glCopyBufferSubData into the scene's VBOs. Needs
+//               GL_ARB_buffer_storage, otherwise we fall back to grow
+struct UPLOAD{
+    enum {GROW=0, ORPHAN, PERSISTENT, COUNT};
+};
+
+const char* uploadNames[UPLOAD::COUNT] = {"grow", "orphan", "persistent"};
+int uploadMode = UPLOAD::GROW;
+
+// glBufferStorage is GL 4.4, so it isn't in the 3.3 headers
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
+typedef void (*BufferStorageProc)(GLenum target, GLsizeiptr size, const void* data, GLbitfield flags);
+
+const int STAGING_SLOTS = 8;
+const size_t STAGING_SLOT_BYTES = 4*1024*1024;
+
+GLuint stagingBuffer = 0;
+char* stagingMemory = 0;                    // mapped for as long as the program runs
+GLsync stagingFence[STAGING_SLOTS];         // set once the GPU has been told to copy a slot out
+mutex stagingMutex;
+bool stagingBusy[STAGING_SLOTS];            // guarded by stagingMutex, the worker claims slots too
+
+// vertices [first, first+count) sitting in a staging slot, waiting to be copied into a VBO
+// with the float layout the points come first and the colors right after them
+struct StagedChunk {
+    size_t first;
+    size_t count;
+    int slot;
+};
+
+// sets up the staging ring for --upload persistent
+bool initStaging()
 {
-    glBindBuffer(GL_ARRAY_BUFFER, vbo[VBO::POINTS]);
-    glBufferData(
-                 GL_ARRAY_BUFFER,                       // Which buffer you're loading too
-                 sizeof(vec2)*points.size(),            // Size of data in array (in bytes)
-                 &points[0],							// Start of array (&points[0] will give you pointer to start of vector)
-                 GL_STATIC_DRAW                         // GL_DYNAMIC_DRAW if you're changing the data often
-                                                        // GL_STATIC_DRAW if you're changing seldomly
-                 );
+    BufferStorageProc bufferStorage = (BufferStorageProc)glfwGetProcAddress("glBufferStorage");
+    if(!glfwExtensionSupported("GL_ARB_buffer_storage") || !bufferStorage) {
+        cout << "GL_ARB_buffer_storage is not available, uploading with grow instead" << endl;
+        uploadMode = UPLOAD::GROW;
+        return false;
+    }
     
-    glBindBuffer(GL_ARRAY_BUFFER, vbo[VBO::COLOR]);
-    glBufferData(
-                 GL_ARRAY_BUFFER,
-                 sizeof(vec3)*colors.size(),
-                 &colors[0],
-                 GL_STATIC_DRAW
-                 );
+    GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    glGenBuffers(1, &stagingBuffer);
+    glBindBuffer(GL_COPY_READ_BUFFER, stagingBuffer);
+    bufferStorage(GL_COPY_READ_BUFFER, STAGING_SLOTS*STAGING_SLOT_BYTES, 0, flags);
+    stagingMemory = (char*)glMapBufferRange(GL_COPY_READ_BUFFER, 0, STAGING_SLOTS*STAGING_SLOT_BYTES, flags);
+    for(int i=0; i<STAGING_SLOTS; i++) {
+        stagingFence[i] = 0;
+        stagingBusy[i] = false;
+    }
     
+    if(!stagingMemory) {
+        cout << "Could not map the staging buffer, uploading with grow instead" << endl;
+        glDeleteBuffers(1, &stagingBuffer);
+        stagingBuffer = 0;
+        uploadMode = UPLOAD::GROW;
+    }
     return !CheckGLErrors();
 }
 
+void deleteStaging()
+{
+    if(!stagingBuffer)
+        return;
+    
+    for(int i=0; i<STAGING_SLOTS; i++) {
+        if(stagingFence[i])
+            glDeleteSync(stagingFence[i]);
+    }
+    glBindBuffer(GL_COPY_READ_BUFFER, stagingBuffer);
+    glUnmapBuffer(GL_COPY_READ_BUFFER);
+    glDeleteBuffers(1, &stagingBuffer);
+    stagingBuffer = 0;
+    stagingMemory = 0;
+}
+
+// hands out a free slot, or -1 if they're all in use
+int claimStagingSlot()
+{
+    lock_guard<mutex> lock(stagingMutex);
+    for(int i=0; i<STAGING_SLOTS; i++) {
+        if(!stagingBusy[i]) {
+            stagingBusy[i] = true;
+            return i;
+        }
+    }
+    return -1;
+}
+
+// frees the slots the GPU has finished copying out of
+void retireStaging()
+{
+    for(int i=0; i<STAGING_SLOTS; i++) {
+        if(!stagingFence[i])
+            continue;
+        
+        GLenum status = glClientWaitSync(stagingFence[i], 0, 0);
+        if(status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED) {
+            glDeleteSync(stagingFence[i]);
+            stagingFence[i] = 0;
+            lock_guard<mutex> lock(stagingMutex);
+            stagingBusy[i] = false;
+        }
+    }
+}
+
+// gives back slots that were filled but are never going to be copied from
+void releaseStaging(vector<StagedChunk>& staged)
+{
+    lock_guard<mutex> lock(stagingMutex);
+    for(size_t i=0; i<staged.size(); i++)
+        stagingBusy[staged[i].slot] = false;
+    staged.clear();
+}
+
 // Compile and link shaders, storing the program ID in shader array
 bool initShader()
 {
@@ -206,413 +675,826 @@ bool initShader()
     
     shader[SHADER::LINE] = LinkProgram(vertexID, fragmentID);	// Link and store program ID in shader array
     
+    // the escape-time scenes are drawn as a textured quad with their own pair
+    vertexID = CompileShader(GL_VERTEX_SHADER, LoadSource("image_vertex.glsl"));
+    fragmentID = CompileShader(GL_FRAGMENT_SHADER, LoadSource("image_fragment.glsl"));
+    shader[SHADER::IMAGE] = LinkProgram(vertexID, fragmentID);
+    
+    // the image is always on texture unit 0
+    glUseProgram(shader[SHADER::IMAGE]);
+    glUniform1i(glGetUniformLocation(shader[SHADER::IMAGE], "Image"), 0);
+    
+    return !CheckGLErrors();
+}
+
+// --------------------------------------------------------------------------
+// Geometry cache
+
+// glfwWaitEvents() wakes us up for mouse moves, focus changes and key releases,
+// so instead of regenerating the scene on every redraw we remember the geometry
+// for each (scene, level, width, height) along with the buffers it was uploaded to.
+// Scenes with an image in the registry only keep a texture the size of the window
+// and draw it over the whole window, no vertices at all
+struct CacheEntry {
+    int scene;
+    int level;
+    int width;
+    int height;
+    
+    GLenum mode;                            // primitive type passed to glDrawArrays
+    GLsizei count;                          // number of vertices to draw
+    size_t capacity;                        // number of vertices the VBOs have room for
+    size_t bytes;                           // CPU + GPU memory held by this entry
+    
+    GLuint vao;
+    GLuint vbo[VBO::COUNT];
+    GLuint texture;                         // 0 unless the scene is drawn as an image
+    int stride;                             // 1 once it's finished, or the stride of the coarse pass it shows so far
+    EscapeView view;                        // what part of the plane an image shows
+    vector<vec2> points;
+    vector<vec3> colors;
+};
+
+list<CacheEntry> geometryCache;             // most recently used entry is at the front
+size_t cacheBytes = 0;
+size_t cacheBudget = 256*1024*1024;         // evict old entries once we hold more than this
+
+// looks up a cached scene and marks it as the most recently used
+// images are only the same if they're of the same view
+CacheEntry* findCacheEntry(int scene, int level, int width, int height, const EscapeView& view)
+{
+    for(list<CacheEntry>::iterator it = geometryCache.begin(); it != geometryCache.end(); ++it) {
+        if(it->scene == scene && it->level == level && it->width == width && it->height == height &&
+           (!it->texture || sameView(it->view, view))) {
+            geometryCache.splice(geometryCache.begin(), geometryCache, it);
+            return &geometryCache.front();
+        }
+    }
+    return 0;
+}
+
+// drops least recently used entries until we're back under budget
+// the front entry is never evicted since it's the one being drawn
+void evictCache(size_t budget)
+{
+    while(cacheBytes > budget && geometryCache.size() > 1) {
+        CacheEntry& entry = geometryCache.back();
+        deleteIDs(entry.vao, entry.vbo);
+        glDeleteTextures(1, &entry.texture);
+        cacheBytes -= entry.bytes;
+        geometryCache.pop_back();
+    }
+}
+
+void clearCache()
+{
+    evictCache(0);
+    if(!geometryCache.empty()) {
+        deleteIDs(geometryCache.front().vao, geometryCache.front().vbo);
+        glDeleteTextures(1, &geometryCache.front().texture);
+        geometryCache.clear();
+    }
+    cacheBytes = 0;
+}
+
+// recomputes how much memory an entry holds after its geometry changed size
+void updateCacheBytes(CacheEntry& entry)
+{
+    cacheBytes -= entry.bytes;
+    entry.bytes = sizeof(vec2)*entry.points.capacity() + sizeof(vec3)*entry.colors.capacity();
+    entry.bytes += vertexBytes()*entry.capacity;
+    if(entry.texture)
+        entry.bytes += 4*(size_t)entry.width*entry.height;
+    cacheBytes += entry.bytes;
+}
+
+// sends vertices [begin, end) of an entry from the CPU with glBufferSubData
+// with --compact, packed holds the vertices from packedFirst on and anything before that is packed here
+void sendVertices(CacheEntry& entry, size_t begin, size_t end, const vector<PackedVertex>& packed, size_t packedFirst)
+{
+    if(end <= begin)
+        return;
+    
+    if(compactVertices) {
+        vector<PackedVertex> scratch;
+        const PackedVertex* data;
+        if(begin >= packedFirst)
+            data = &packed[begin - packedFirst];
+        else {
+            packVertices(entry.points, entry.colors, begin, end, scratch);
+            data = scratch.data();
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, entry.vbo[VBO::POINTS]);
+        glBufferSubData(GL_ARRAY_BUFFER, sizeof(PackedVertex)*begin, sizeof(PackedVertex)*(end-begin), data);
+    }
+    else {
+        glBindBuffer(GL_ARRAY_BUFFER, entry.vbo[VBO::POINTS]);
+        glBufferSubData(GL_ARRAY_BUFFER, sizeof(vec2)*begin, sizeof(vec2)*(end-begin), &entry.points[begin]);
+        glBindBuffer(GL_ARRAY_BUFFER, entry.vbo[VBO::COLOR]);
+        glBufferSubData(GL_ARRAY_BUFFER, sizeof(vec3)*begin, sizeof(vec3)*(end-begin), &entry.colors[begin]);
+    }
+    currentFrame->bytes += vertexBytes()*(end-begin);
+}
+
+// Loads buffers with data
+// Uploads vertices [first, end) of an entry whose buffers already hold everything
+// before first, the way --upload says to. packed holds the --compact vertices from
+// first on and staged the chunks the worker already copied into the staging ring
+bool loadBuffer(CacheEntry& entry, size_t first, const vector<PackedVertex>& packed, vector<StagedChunk>& staged)
+{
+    size_t count = entry.points.size();
+    
+    if(count > entry.capacity || uploadMode == UPLOAD::ORPHAN) {
+        if(count > entry.capacity)
+            entry.capacity = std::max(count, 2*entry.capacity);
+        
+        // a null pointer just (re)allocates the store, the data follows with glBufferSubData
+        // GL_STREAM_DRAW tells the driver we're about to replace it again soon
+        GLenum usage = uploadMode == UPLOAD::ORPHAN ? GL_STREAM_DRAW : GL_STATIC_DRAW;
+        if(compactVertices) {
+            glBindBuffer(GL_ARRAY_BUFFER, entry.vbo[VBO::POINTS]);
+            glBufferData(GL_ARRAY_BUFFER, sizeof(PackedVertex)*entry.capacity, 0, usage);
+        }
+        else {
+            glBindBuffer(GL_ARRAY_BUFFER, entry.vbo[VBO::POINTS]);
+            glBufferData(GL_ARRAY_BUFFER, sizeof(vec2)*entry.capacity, 0, usage);
+            glBindBuffer(GL_ARRAY_BUFFER, entry.vbo[VBO::COLOR]);
+            glBufferData(GL_ARRAY_BUFFER, sizeof(vec3)*entry.capacity, 0, usage);
+        }
+        
+        // whatever was in there is gone, so send it again
+        sendVertices(entry, 0, first, packed, first);
+    }
+    
+    // copy over what the worker staged, then send whatever didn't fit from the CPU
+    size_t sent = first;
+    for(size_t i=0; i<staged.size(); i++) {
+        const StagedChunk& chunk = staged[i];
+        size_t slot = chunk.slot*STAGING_SLOT_BYTES;
+        glBindBuffer(GL_COPY_READ_BUFFER, stagingBuffer);
+        if(compactVertices) {
+            glBindBuffer(GL_ARRAY_BUFFER, entry.vbo[VBO::POINTS]);
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_ARRAY_BUFFER, slot, sizeof(PackedVertex)*chunk.first, sizeof(PackedVertex)*chunk.count);
+        }
+        else {
+            glBindBuffer(GL_ARRAY_BUFFER, entry.vbo[VBO::POINTS]);
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_ARRAY_BUFFER, slot, sizeof(vec2)*chunk.first, sizeof(vec2)*chunk.count);
+            glBindBuffer(GL_ARRAY_BUFFER, entry.vbo[VBO::COLOR]);
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_ARRAY_BUFFER, slot + sizeof(vec2)*chunk.count, sizeof(vec3)*chunk.first, sizeof(vec3)*chunk.count);
+        }
+        
+        // the slot can be reused once the GPU is done with the copy
+        stagingFence[chunk.slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        currentFrame->bytes += vertexBytes()*chunk.count;
+        sent = chunk.first + chunk.count;
+    }
+    staged.clear();
+    sendVertices(entry, sent, count, packed, first);
+    
     return !CheckGLErrors();
 }
 
-void generateSquares(int level) {
-    points.clear();
-    colors.clear();
-    
-    // set unique colors for squares and diamonds
-    vec3 squareColour(1.0, 0.5, 0.0);
-    vec3 diamondColor(0.0, 0.5, 1.0);
-    // set initial dimensions of the square
-    float size = 0.9;
-    
-    // each level draws a square containing a diamond
-    for(int i=0; i<level; i++) {
-        // draw a mediocre square
-        points.push_back(vec2(-size, -size));
-        points.push_back(vec2(-size,  size));
-        colors.push_back(squareColour);
-        colors.push_back(squareColour);
-        points.push_back(vec2(-size,  size));
-        points.push_back(vec2( size,  size));
-        colors.push_back(squareColour);
-        colors.push_back(squareColour);
-        points.push_back(vec2( size,  size));
-        points.push_back(vec2( size, -size));
-        colors.push_back(squareColour);
-        colors.push_back(squareColour);
-        points.push_back(vec2( size, -size));
-        points.push_back(vec2(-size, -size));
-        colors.push_back(squareColour);
-        colors.push_back(squareColour);
-    
-        // draw a mediocre diamond
-        points.push_back(vec2( 0.0, -size));
-        points.push_back(vec2(-size,  0.0));
-        colors.push_back(diamondColor);
-        colors.push_back(diamondColor);
-        points.push_back(vec2(-size,  0.0));
-        points.push_back(vec2( 0.0,  size));
-        colors.push_back(diamondColor);
-        colors.push_back(diamondColor);
-        points.push_back(vec2( 0.0,  size));
-        points.push_back(vec2( size,  0.0));
-        colors.push_back(diamondColor);
-        colors.push_back(diamondColor);
-        points.push_back(vec2( size,  0.0));
-        points.push_back(vec2( 0.0, -size));
-        colors.push_back(diamondColor);
-        colors.push_back(diamondColor);
+// Loads an image scene into the entry's texture, 4 bytes a pixel
+// the storage is allocated the first time and then filled with glTexSubImage2D,
+// so the passes of a progressive image all land in the same texture
+bool loadTexture(CacheEntry& entry, const vector<unsigned char>& rgba)
+{
+    if(entry.texture)
+        glBindTexture(GL_TEXTURE_2D, entry.texture);
+    else {
+        glGenTextures(1, &entry.texture);
+        glBindTexture(GL_TEXTURE_2D, entry.texture);
+        
+        // one texel per pixel, so there's nothing to filter
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
         
-        size /= 2;
-        // fade the color towards black a little bit each iteration
-        squareColour *= 0.8;
-        diamondColor *= 0.8;
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, entry.width, entry.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, 0);
     }
+    if(rgba.size() >= 4*(size_t)entry.width*entry.height)
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, entry.width, entry.height, GL_RGBA, GL_UNSIGNED_BYTE, rgba.data());
+    currentFrame->bytes += rgba.size();
+    
+    return !CheckGLErrors();
 }
 
-void generateSpiral(int level){
-    points.clear();
-    colors.clear();
+// finds the most recently used entry of a scene at any level
+CacheEntry* findSceneEntry(int scene, int width, int height)
+{
+    for(list<CacheEntry>::iterator it = geometryCache.begin(); it != geometryCache.end(); ++it) {
+        if(it->scene == scene && it->width == width && it->height == height)
+            return &*it;
+    }
+    return 0;
+}
+
+// moves an entry to the front of the cache and gives it a new level
+CacheEntry* rekeyCacheEntry(CacheEntry* entry, int level)
+{
+    for(list<CacheEntry>::iterator it = geometryCache.begin(); it != geometryCache.end(); ++it) {
+        if(&*it == entry) {
+            geometryCache.splice(geometryCache.begin(), geometryCache, it);
+            break;
+        }
+    }
+    entry->level = level;
+    entry->count = entry->points.size();
+    return entry;
+}
+
+// stepping down the squares or the fern just drops vertices, which is cheap
+// enough to do right away instead of handing it to the worker
+CacheEntry* truncateCacheEntry(int scene, int level, int width, int height)
+{
+    CacheEntry* entry = findSceneEntry(scene, width, height);
+    if(!entry || entry->level < level || !truncateScene(scene, level, entry->points, entry->colors))
+        return 0;
     
-    // define start and end colors for the spiral to fade between
-    vec3 startColor(0.0, 1.0, 0.5);
-    vec3 endColor(1.0, 0.0, 0.5);
+    // the VBOs keep their contents, we just draw fewer of them
+    rekeyCacheEntry(entry, level);
+    updateCacheBytes(*entry);
+    return entry;
+}
+
+// --------------------------------------------------------------------------
+// Admission control
+
+// Every level is checked against a memory and a time budget before anything gets
+// generated for it. Over budget we fall back to the highest level that fits, and
+// if not even level 0 fits (the Mandelbrot and Julia sets take the same memory at
+// every level) the request is turned down. Either way the title bar says what is
+// actually being drawn.
+double memoryBudget = 256*1024*1024;        // --budget MB: CPU + GPU bytes a single scene may take
+double timeBudget = 0;                      // --time-budget ms: how long generating may take, 0 for no limit
+vector<double> msPerWork;                   // how fast each scene generated last time, 0 until we know
+
+// what a scene would cost us in memory: the CPU copy plus its GPU buffers, or
+// for an image everything it's made with plus its RGBA8 texture
+double sceneBytes(int scene, int level, int width, int height)
+{
+    if(findScene(scene)->image)
+        return estimateImageBytes(scene, width, height) + 4.0*width*height;
+    return estimateBytes(scene, level, width, height) + estimateVertices(scene, level, width, height)*vertexBytes();
+}
+
+// how long generating a scene should take, or 0 if we haven't timed that scene yet
+double sceneMs(int scene, int level, int width, int height)
+{
+    if(scene >= (int)msPerWork.size())
+        return 0;
+    return msPerWork[scene]*estimateWork(scene, level, width, height);
+}
+
+// remembers how fast a scene generated so the time budget has something to go on
+void recordGenerateTime(int scene, int level, int width, int height, double ms)
+{
+    // anything quicker than this is mostly overhead and would make big levels look slow
+    double work = estimateWork(scene, level, width, height);
+    if(ms < 1.0 || work <= 0)
+        return;
     
-    float t = 0;
-    float bound = level*2*3.141592653589793238462643383;
-    // an interval of 0.01 between points produces a nice smooth spiral
-    float interval = 0.01;
-    float a = (1/bound);
+    if(scene >= (int)msPerWork.size())
+        msPerWork.resize(scene+1, 0.0);
+    msPerWork[scene] = ms/work;
+}
+
+// which budget a level is over, or null if it fits
+const char* overBudget(int scene, int level, int width, int height)
+{
+    if(sceneBytes(scene, level, width, height) > memoryBudget)
+        return "memory";
+    if(timeBudget > 0 && sceneMs(scene, level, width, height) > timeBudget)
+        return "time";
+    return 0;
+}
+
+// the highest level up to `level` that fits the budgets, or -1 if none of them do
+int admitLevel(int scene, int level, int width, int height)
+{
+    if(!overBudget(scene, level, width, height))
+        return level;
+    if(overBudget(scene, 0, width, height))
+        return -1;
     
-    // generate the spiral with a simple parametric equation
-    // blend between the start and end colors
-    for(t=0; t<bound; t+=interval) {
-        points.push_back(vec2(a*t*cos(t), a*t*sin(t)));
-        colors.push_back(startColor*(1-(a*t)) + endColor*(a*t));
+    // the estimates only grow with the level, so binary search for the last one that fits
+    int low = 0;
+    int high = level;
+    while(high - low > 1) {
+        int middle = low + (high - low)/2;
+        if(overBudget(scene, middle, width, height))
+            high = middle;
+        else
+            low = middle;
     }
+    return low;
 }
 
-void drawTriangle(int level, vec2 pointA, vec2 pointB, vec2 pointC, vec3 color) {
-    // added a failsafe to make sure the render doesn't melt your CPU
-    while(level > 10)
-        level--;
+// rebuilds the title bar text when the scene, the level asked for, the level drawn or the Julia set's c changes
+int statusScene = 0;
+int statusLevel = -1;
+int statusDrawn = -1;
+double statusJuliaX = 0.0;
+double statusJuliaY = 0.0;
+
+void updateSceneStatus(int scene, int level, int drawLevel)
+{
+    if(scene == statusScene && level == statusLevel && drawLevel == statusDrawn &&
+       view.juliaX == statusJuliaX && view.juliaY == statusJuliaY)
+        return;
+    statusScene = scene;
+    statusLevel = level;
+    statusDrawn = drawLevel;
+    statusJuliaX = view.juliaX;
+    statusJuliaY = view.juliaY;
+    
+    char status[256];
+    const char* name = findScene(scene)->name;
+    if(drawLevel == level)
+        snprintf(status, sizeof(status), "%s level %d", name, level);
+    else if(drawLevel < 0)
+        snprintf(status, sizeof(status), "%s level %d is over the %s budget", name, level, overBudget(scene, level, width, height));
+    else
+        snprintf(status, sizeof(status), "%s level %d (level %d is over the %s budget)", name, drawLevel, level,
+                 overBudget(scene, level, width, height));
+    sceneStatus = status;
     
-    if(level<=0) {
-        // draw triangle with vertexes A, B, and C
-        points.push_back(pointA);
-        points.push_back(pointB);
-        points.push_back(pointC);
-        colors.push_back(color);
-        colors.push_back(color);
-        colors.push_back(color);
+    // the Julia set says which one it is
+    if(findScene(scene)->image == imageFormula<ESCAPE::JULIA>) {
+        snprintf(status, sizeof(status), ", c = %.6f %+.6fi", view.juliaX, view.juliaY);
+        sceneStatus += status;
     }
-    else {
-        // calculate the midpoints of the current triangle, and then recursively draw 3 smaller triangles using two of the midpoints and one of the original corners
-        // it also recursively increases one RGB value while decreasing the other two values - produces a cool swirl effect
-        drawTriangle(level-1, pointA, vec2((pointA.x+pointB.x)/2, (pointA.y+pointB.y)/2), vec2((pointA.x+pointC.x)/2, (pointA.y+pointC.y)/2), color*vec3(1.2, 0.8, 0.8));
-        drawTriangle(level-1, pointB, vec2((pointB.x+pointA.x)/2, (pointB.y+pointA.y)/2), vec2((pointB.x+pointC.x)/2, (pointB.y+pointC.y)/2), color*vec3(0.8, 1.2, 0.8));
-        drawTriangle(level-1, pointC, vec2((pointC.x+pointA.x)/2, (pointC.y+pointA.y)/2), vec2((pointC.x+pointB.x)/2, (pointC.y+pointB.y)/2), color*vec3(0.8, 0.8, 1.2));
-    }
-}
-
-void generateSierpinski(int level) {
-    points.clear();
-    colors.clear();
-
-    // set the intial color value and then get started on the recursion (yee haw)
-    vec3 color(0.5, 0.5, 0.5);
-    drawTriangle(level, vec2(-1.0, -0.933), vec2(0.0, 0.933), vec2(1.0, -0.933), color);
-}
-
-void generateSnowFractal(int level){
-    // TODO: make da snow fractal (if you feel sassy enough)
-    // this fractal reminded me of winter and that put me in a foul mood
-    // instead of snow fractals, I made a dragon curve, which you'll have to admit is way more badass
-}
-
-void generateFern(int level) {
-    points.clear();
-    colors.clear();
-    
-    // set initial color value
-    vec3 color(0.5, 0.5, 0.5);
-    
-    float x = 0;
-    float y = 0;
-    float xPrev;
-    float yPrev;
-    
-    // since this fractal is probability-based, it needs TONS of iterations
-    level = level*50000;
-    for (int i = 0; i<level; i++) {
-        xPrev = x;
-        yPrev = y;
-        // choose a random number between 0 and 99
-        // depending on the result, the next point to be drawn gets mapped to a new part of the fern based on specific probabilities
-        int seed = rand()%100;
-        // maps to the first stem
-        if(seed == 0) {
-            x = 0;
-            y = 0.16*yPrev;
-            // make the stem white
-            color = vec3(1.0, 1.0, 1.0);
+}
+
+// --------------------------------------------------------------------------
+// Background generation
+
+// Generating a big scene can take hundreds of milliseconds, so it happens on a
+// worker thread and the window keeps drawing the last geometry that finished.
+// The cache entries act as the front buffers and each job carries the back
+// buffer the worker fills in. There's only ever one job waiting: asking for
+// something new replaces it and cancels the one the worker is running.
+struct GenerationJob {
+    int id;
+    int scene;
+    int level;
+    int width;
+    int height;
+    
+    int baseLevel;                          // level of the cache entry being stepped, or -1 to start over
+    size_t baseOffset;                      // index in that entry that points[0] corresponds to
+    size_t firstChanged;                    // first vertex of the entry that has to be uploaded again
+    bool stepped;
+    int stride;                             // 1 once the job is done, or the stride of the image pass it's up to
+    EscapeView view;
+    bool coarseToFine;                      // make the image a pass at a time (with --progressive or while steering)
+    bool reused;                            // an image that started out from part of the last one
+    double estimateMs;                      // how long the whole scene should take, 0 if we don't know yet
+    double generateMs;                      // how long the worker spent on it
+    long long skipped;                      // iterations the escape-time interior checks saved
+    long long antialiased;                  // extra samples --antialias took
+    
+    GLenum mode;
+    vector<vec2> points;
+    vector<vec3> colors;
+    vector<unsigned char> rgba;             // image scenes fill this instead of points/colors
+    vector<PackedVertex> packed;            // with --compact, the vertices from firstChanged on
+    vector<StagedChunk> staged;             // with --upload persistent, the vertices already in the staging ring
+};
+
+thread worker;
+mutex jobMutex;
+condition_variable jobReady;
+GenerationJob pendingJob;                   // waiting for the worker
+GenerationJob finishedJob;                  // waiting for the GL thread
+bool hasPendingJob = false;
+bool hasFinishedJob = false;
+bool quitWorker = false;
+
+// scene the GL thread is waiting on, so redraws don't ask for it again
+int jobScene = 0;
+int jobLevel = -1;
+int jobWidth = 0;
+int jobHeight = 0;
+EscapeView jobView;
+
+// With --progressive [ms] the image scenes are made coarse to fine instead of
+// all at once, and every pass but the last is shown as soon as it's done. The
+// frame target decides the passes: the first one is the finest that the
+// scene's last timing says will finish within it, and every pass after that is
+// the finest one that fits going by how long the pass before took per pixel,
+// but at least twice as fine. So an image that's quick to make is done in one
+// go, and a slow one typically shows up at 1/16, 1/4 and then full resolution.
+// The first pass goes as coarse as every 64th pixel each way (about 120 pixels
+// in a 700x700 window) when 1/16 would take too long or we have no timing yet,
+// which keeps the first image inside the target even at huge levels.
+//
+// A zoom shows the last image scaled onto the new view before any of that,
+// as a pass coarser than all the others. A new Julia set shows its outline
+// there instead (see outlineJulia), whenever it won't be done within the
+// target, and then skips the coarse passes since the outline already shows
+// where everything is.
+//
+// Steering the Julia set always goes coarse to fine, since every move of the
+// mouse is a new image: each one gets whatever resolution fits the target
+// (going by how long the last pass took) and is cancelled by the next move,
+// and the one the mouse stops on carries on to full resolution.
+bool progressive = false;
+double frameTarget = 16;                    // ms each pass should take
+const int MAX_STRIDE = 64;
+const int PREVIEW_STRIDE = 2*MAX_STRIDE;
+
+// the image the worker made last, which it starts the next one from (only the worker touches these)
+EscapeImage escapeImage;
+int escapeScene = 0;
+double passMsPerPixel = 0;                  // how long the last pass of it took a pixel
+
+// the stride of the pass after the one at `done` (0 for the first pass)
+int nextStride(const EscapeImage& image, int done, double msPerPixel)
+{
+    if(msPerPixel <= 0)
+        return done ? done/2 : MAX_STRIDE;
+    int coarsest = done ? done/2 : MAX_STRIDE;
+    int stride = 1;
+    while(stride < coarsest && msPerPixel*imageSamples(image, stride) > frameTarget)
+        stride *= 2;
+    return stride;
+}
+
+// hands a copy of a job that isn't finished yet to the GL thread, so it can show
+// it while the worker carries on
+void publishJob(const GenerationJob& job)
+{
+    GenerationJob partial = job;
+    {
+        lock_guard<mutex> lock(jobMutex);
+        if(generationCancelled())
+            return;
+        swap(finishedJob, partial);
+        hasFinishedJob = true;
+    }
+    releaseStaging(partial.staged);
+    glfwPostEmptyEvent();
+}
+
+void runJob(GenerationJob& job)
+{
+    double start = profileTime();
+    long long skipped = escapeSkippedIterations();
+    long long antialiased = escapeAntialiasSamples();
+    job.stepped = false;
+    job.stride = 1;
+    job.reused = false;
+    job.rgba.clear();
+    const SceneInfo* info = findScene(job.scene);
+    if(info && info->image) {
+        // drawn as 4 vertices of a triangle strip covering the window, see image_vertex.glsl
+        job.mode = GL_TRIANGLE_STRIP;
+        job.firstChanged = 0;
+        job.points.clear();
+        job.colors.clear();
+        job.packed.clear();
+        
+        // start from whatever's left of the last image, which for a pan is
+        // everything but the strips that just came on screen
+        bool similar = escapeScene == job.scene && escapeImage.width == job.width && escapeImage.height == job.height;
+        bool zoomed = similar && !sameLattice(escapeImage.view, job.view);
+        
+        // steering only moves c, and only a little from one job to the next, so
+        // the old image isn't worth showing as a preview and the last pass's
+        // timing is the best guess at how long the next one takes
+        EscapeView unsteered = job.view;
+        unsteered.juliaX = escapeImage.view.juliaX;
+        unsteered.juliaY = escapeImage.view.juliaY;
+        bool steered = similar && escapeImage.level == job.level && zoomed && sameView(escapeImage.view, unsteered);
+        zoomed = zoomed && !steered;
+        bool newJulia = !similar || escapeImage.view.juliaX != job.view.juliaX || escapeImage.view.juliaY != job.view.juliaY;
+        escapeScene = job.scene;
+        info->image(job.level, job.width, job.height, job.view, 0, escapeImage);
+        job.reused = imageSamples(escapeImage, 1) < (long)job.width*job.height;
+        
+        // there's nothing of a new Julia set to show yet, so if it won't be done
+        // within the frame target it gets its outline first, which is sharper
+        // than a coarse pass and usually quicker, and the image is then made in
+        // one go behind it
+        bool outlined = info->image == imageFormula<ESCAPE::JULIA> && newJulia && (job.estimateMs <= 0 || job.estimateMs > frameTarget) &&
+                        outlineJulia(job.width, job.height, job.view, job.rgba);
+        if(zoomed || outlined) {
+            if(!outlined)
+                job.rgba = escapeImage.rgba;
+            job.stride = PREVIEW_STRIDE;
+            job.generateMs = profileTime() - start;
+            publishJob(job);
         }
-        // maps to the next level
-        else if(0<seed && seed<=85) {
-            x = 0.85*xPrev + 0.04*yPrev;
-            y = -0.04*xPrev + 0.85*yPrev + 1.6;
-            // make the fern fade out near the tip
-            color *= vec3(0.95, 0.95, 0.95);
+        
+        if(!job.coarseToFine || outlined)
+            info->image(job.level, job.width, job.height, job.view, 1, escapeImage);
+        
+        double msPerPixel = job.estimateMs/std::max(1.0, (double)job.width*job.height);
+        if(steered && passMsPerPixel > 0)
+            msPerPixel = passMsPerPixel;
+        for(int done = 0; job.coarseToFine && !outlined && done != 1 && !generationCancelled(); ) {
+            int stride = nextStride(escapeImage, done, msPerPixel);
+            long samples = imageSamples(escapeImage, stride);
+            double passStart = profileTime();
+            info->image(job.level, job.width, job.height, job.view, stride, escapeImage);
+            if(samples > 0 && !generationCancelled())
+                passMsPerPixel = msPerPixel = (profileTime() - passStart)/samples;
+            job.stride = done = stride;
+            
+            if(stride > 1) {
+                job.rgba = escapeImage.rgba;
+                job.generateMs = profileTime() - start;
+                job.skipped = escapeSkippedIterations() - skipped;
+                job.antialiased = escapeAntialiasSamples() - antialiased;
+                publishJob(job);
+            }
         }
-        // maps to the left side
-        else if(85<seed && seed<=92) {
-            x = 0.2*xPrev - 0.26*yPrev;
-            y = 0.23*xPrev + 0.22*yPrev + 1.6;
-            // make the left side red
-            color = vec3(1.0, 0.2, 0.2);
+        job.stride = 1;
+        job.rgba = escapeImage.rgba;
+        job.generateMs = profileTime() - start;
+        job.skipped = escapeSkippedIterations() - skipped;
+        job.antialiased = escapeAntialiasSamples() - antialiased;
+        return;
+    }
+    if(job.baseLevel >= 0) {
+        size_t first;
+        job.stepped = stepScene(job.scene, job.baseLevel, job.level, job.points, job.colors, first);
+        job.firstChanged = job.baseOffset + first;
+    }
+    if(!job.stepped) {
+        job.mode = glPrimitive[generateScene(job.scene, job.level, job.width, job.height, job.points, job.colors)];
+        job.firstChanged = 0;
+    }
+    // packing is part of making the vertices, so it's done here rather than on the GL thread
+    if(compactVertices)
+        packVertices(job.points, job.colors, job.firstChanged - (job.stepped ? job.baseOffset : 0), job.points.size(), job.packed);
+    job.generateMs = profileTime() - start;
+    job.skipped = escapeSkippedIterations() - skipped;
+    job.antialiased = escapeAntialiasSamples() - antialiased;
+}
+
+// copies the vertices that changed into free staging slots, a chunk at a time, so
+// all the GL thread has left to do is glCopyBufferSubData. Whatever doesn't fit
+// gets sent from the CPU as usual
+void stageJob(GenerationJob& job)
+{
+    size_t offset = job.stepped ? job.baseOffset : 0;           // index in the entry of job.points[0]
+    size_t end = offset + job.points.size();
+    size_t perChunk = STAGING_SLOT_BYTES/vertexBytes();
+    
+    for(size_t first = job.firstChanged; first < end; first += perChunk) {
+        int slot = claimStagingSlot();
+        if(slot < 0)
+            break;
+        
+        StagedChunk chunk = {first, std::min(perChunk, end - first), slot};
+        char* memory = stagingMemory + slot*STAGING_SLOT_BYTES;
+        if(compactVertices)
+            memcpy(memory, &job.packed[first - job.firstChanged], sizeof(PackedVertex)*chunk.count);
+        else {
+            memcpy(memory, &job.points[first - offset], sizeof(vec2)*chunk.count);
+            memcpy(memory + sizeof(vec2)*chunk.count, &job.colors[first - offset], sizeof(vec3)*chunk.count);
         }
-        //maps to the right side
-        else if(92<seed && seed<=99) {
-            x = -0.15*xPrev + 0.28*yPrev;
-            y = 0.26*xPrev + 0.24*yPrev + 0.44;
-            // make the right side blue
-            color = vec3(0.2, 0.2, 1.0);
+        job.staged.push_back(chunk);
+    }
+}
+
+void workerMain()
+{
+    GenerationJob job;
+    
+    while(true) {
+        {
+            unique_lock<mutex> lock(jobMutex);
+            while(!hasPendingJob && !quitWorker)
+                jobReady.wait(lock);
+            if(quitWorker)
+                return;
+            
+            swap(job, pendingJob);
+            hasPendingJob = false;
+            runningJob = job.id;
         }
         
-        // apply some scaling and translating to make sure it fits in the render window
-        points.push_back(vec2((x/3), (y/5.3)-1.0));
-        colors.push_back(color);
-    }
-}
-
-vec2 plotLeft(vec2 pointA, vec2 pointB, int mode) {
-    // calculate midpoint of A and B
-    vec2 midpoint((pointA.x+pointB.x)/2, (pointA.y+pointB.y)/2);
-    // calculate the change in each dimension
-    vec2 delta = midpoint - pointA;
-    
-    // depending on which mode we're in, calcluate the extrusion on the left
-    if(mode%4 == 0)
-        return vec2(midpoint.x, midpoint.y+delta.x);
-    if(mode%4 == 1)
-        return vec2(pointA.x, pointB.y);
-    if(mode%4 == 2)
-        return vec2(midpoint.x-delta.y, midpoint.y);
-    if(mode%4 == 3)
-        return vec2(pointB.x, pointA.y);
-    
-    // this is here for bug catching
-    // under normal circumstances this should never be returned
-    return vec2(2.0, 2.0);
-}
-
-vec2 plotRight(vec2 pointA, vec2 pointB, int mode) {
-    // calculate midpoint of A and B
-    vec2 midpoint((pointA.x+pointB.x)/2, (pointA.y+pointB.y)/2);
-    // calculate the change in each dimension
-    vec2 delta = midpoint - pointA;
-    
-    // depending on which mode we're in, calcluate the extrusion on the right
-    if(mode%4 == 0)
-        return vec2(midpoint.x, midpoint.y-delta.x);
-    if(mode%4 == 1)
-        return vec2(pointB.x, pointA.y);
-    if(mode%4 == 2)
-        return vec2(midpoint.x+delta.y, midpoint.y);
-    if(mode%4 == 3)
-        return vec2(pointA.x, pointB.y);
-    
-    // this is here for bug catching
-    // under normal circumstances, this should never be returned
-    return vec2(2.0, 2.0);
-}
-
-void generateDragon(int level) {
-    points.clear();
-    colors.clear();
-    
-    // added a failsafe to make sure the render doesn't melt the CPU
-    while(level > 17)
-        level--;
-    
-    bool right = true;
-    vector<vec2> array;
-    
-    // initial coordinates and colors
-    array.push_back(vec2(-0.7, 0.2));
-    array.push_back(vec2(0.5, 0.2));
-    vec3 startColor(0.0, 0.6, 0.9);
-    vec3 endColor(1.0, 0.4, 0.1);
-    
-    // there are 4 "modes" to aid with folding calculations
-    // the mode tells the function which way the line is propagating, so it know which way to extrude
-    // Mode 0 = west/east
-    // Mode 1 = northeast/southwest
-    // Mode 2 = north/south
-    // Mode 3 = northwest/southeast
-    int mode = 0;
-    while(level > 1) {
-        // iterate through the vector of values, use adjacent values to calculate intermediate values and insert them back into the vector
-        for(int index=0; index < array.size()-1; index += 2) {
-            // alternate between turning left and right
-            if(right) {
-                array.insert(array.begin() + index+1, plotRight(array.at(index), array.at(index+1), mode));
-                right = false;
-            }
-            else if(!right) {
-                array.insert(array.begin() + index+1, plotLeft(array.at(index), array.at(index+1), mode));
-                right = true;
+        runJob(job);
+        if(stagingMemory && !generationCancelled())
+            stageJob(job);
+        
+        {
+            lock_guard<mutex> lock(jobMutex);
+            if(generationCancelled()) {
+                releaseStaging(job.staged);
+                continue;
             }
-            // a 90 turn = a mode shift of 2
-            mode += 2;
+            swap(finishedJob, job);
+            hasFinishedJob = true;
         }
-        // shift the mode to prepare for the next level
-        mode++;
-        level--;
+        
+        // if that replaced a job the GL thread never picked up, its slots are free again
+        releaseStaging(job.staged);
+        
+        // wake the GL thread up out of glfwWaitEvents() so it can show the result
+        glfwPostEmptyEvent();
+    }
+}
+
+void startWorker()
+{
+    worker = thread(workerMain);
+}
+
+void stopWorker()
+{
+    {
+        lock_guard<mutex> lock(jobMutex);
+        quitWorker = true;
+        requestedJob++;                     // cancels whatever is running
     }
+    jobReady.notify_one();
+    worker.join();
+}
+
+// cancels the job in flight (if any) because the scene it was making isn't wanted anymore
+void cancelJob()
+{
+    if(jobLevel < 0)
+        return;
     
-    // draw all points and blend between two colors
-    float size = array.size();
-    for(int i=0; i<array.size(); i++) {
-        points.push_back(array[i]);
-        colors.push_back(startColor*(1-(i/size)) + endColor*(i/size));
-    }
-}
-
-vec3 hsv_to_rgb(float h, float s, float v) {
-    if(v>1.0)
-        v = 1.0;
-    float hp = h/60.0;
-    float c = v*s;
-    float x = c*(1-abs((fmod(hp, 2)-1)));
-    vec3 rgb(0.0, 0.0, 0.0);
-    
-    if(0<=hp && hp<1)
-        rgb = vec3(c, x, 0);
-    if(1<=hp && hp<2)
-        rgb = vec3(x, c, 0);
-    if(2<=hp && hp<3)
-        rgb = vec3(0, c, x);
-    if(3<=hp && hp<4)
-        rgb = vec3(0, x, c);
-    if(4<=hp && hp<5)
-        rgb = vec3(x, 0, c);
-    if(5<=hp && hp<6)
-        rgb = vec3(c, 0, x);
-    
-    float m = v - c;
-    rgb += vec3(m, m, m);
-    
-    return rgb;
-}
-
-vec3 mapColor(int i, float r, float c) {
-    int di = i;
-    float zn;
-    float hue;
-    
-    zn = sqrt(r + c);
-    hue = di + 1.0 - log(log(abs(zn))) / log(2.0);
-    hue = 0.95 + 20.0 * hue;
-    while(hue > 360.0)
-        hue -= 360.0;
-    while(hue < 0.0)
-        hue += 360.0;
-    
-    return hsv_to_rgb(hue, 0.8, 1.0);
-}
-
-void generateMandelbrot(int level) {
-    points.clear();
-    colors.clear();
-    
-    float x0;
-    float y0;
-    float x;
-    float y;
-    float xtemp;
-    float ytemp;
-    int levelx;
-    
-    for(int i=0; i<height; i++) {
-        for(int j=0; j<width; j++) {
-            x0 = (3.5/(float)width)*j-2.5;
-            y0 = (3.0/(float)height)*i-1.5;
-            x = 0.0;
-            y = 0.0;
-            levelx = level;
-            while(x*x + y*y < 4.0 && levelx > 0) {
-                xtemp = x*x - y*y + x0;
-                ytemp = 2*x*y + y0;
-                if (x == xtemp  &&  y == ytemp) {
-                    levelx = 0;
-                    break;
-                }
-                x = xtemp;
-                y = ytemp;
-                levelx--;
-            }
-            
-            // some weird scaling stuff, I dunno
-            x0 += 0.75;
-            x0 /= 1.75;
-            y0 /= 1.5;
-            
-            points.push_back(vec2(x0, y0));
-            if(levelx == 0)
-                colors.push_back(vec3(0.0, 0.0, 0.0));
-            else
-                colors.push_back(mapColor(levelx, 360.0*x0+365.0, y0));
+    lock_guard<mutex> lock(jobMutex);
+    requestedJob++;
+    hasPendingJob = false;
+    jobLevel = -1;
+}
+
+// hands a scene to the worker, stepping the most recent entry of the same scene if it can
+void requestScene(int scene, int level, int width, int height, const EscapeView& view)
+{
+    if(jobScene == scene && jobLevel == level && jobWidth == width && jobHeight == height && sameView(jobView, view))
+        return;
+    
+    lock_guard<mutex> lock(jobMutex);
+    
+    GenerationJob& job = pendingJob;
+    job.id = ++requestedJob;
+    job.scene = scene;
+    job.level = level;
+    job.width = width;
+    job.height = height;
+    job.baseLevel = -1;
+    job.baseOffset = 0;
+    job.view = view;
+    job.coarseToFine = progressive || steering;
+    job.estimateMs = sceneMs(scene, level, width, height);
+    job.points.clear();
+    job.colors.clear();
+    
+    // copy over just as much of the previous level as the stepper needs to see
+    CacheEntry* entry = findSceneEntry(scene, width, height);
+    if(entry) {
+        long context = stepContext(scene, entry->level, level, entry->points.size());
+        if(context >= 0) {
+            job.baseLevel = entry->level;
+            job.baseOffset = entry->points.size() - context;
+            job.mode = entry->mode;
+            job.points.assign(entry->points.begin() + job.baseOffset, entry->points.end());
+            job.colors.assign(entry->colors.begin() + job.baseOffset, entry->colors.end());
         }
     }
+    
+    hasPendingJob = true;
+    jobReady.notify_one();
+    
+    jobScene = scene;
+    jobLevel = level;
+    jobWidth = width;
+    jobHeight = height;
+    jobView = view;
 }
 
-void generateJulia(int level) {
-    points.clear();
-    colors.clear();
-    
-    float x0;
-    float y0;
-    float x;
-    float y;
-    float xtemp;
-    float ytemp;
-    int levelx;
-    
-    for(int i=0; i<height; i++) {
-        for(int j=0; j<width; j++) {
-            x0 = (3.5/(float)width)*j-1.75;
-            y0 = (3.0/(float)height)*i-1.5;
-            x = x0;
-            y = y0;
-            levelx = level;
-            while(x*x + y*y < 4.0 && levelx > 0) {
-                xtemp = x*x - y*y - 0.8;
-                ytemp = 2*x*y + 0.156;
-                if (x == xtemp  &&  y == ytemp) {
-                    levelx = 0;
-                    break;
-                }
-                x = xtemp;
-                y = ytemp;
-                levelx--;
-            }
-            
-            // some weird scaling stuff, I dunno
-            x0 /= 1.75;
-            y0 /= 1.5;
-            
-            points.push_back(vec2(x0, y0));
-            if(levelx == 0)
-                colors.push_back(vec3(0.0, 0.0, 0.0));
-            else
-                colors.push_back(mapColor(levelx, 360.0*x0+365.0, y0));
+// puts a finished scene into the cache and uploads it
+void consumeFinishedJob()
+{
+    if(stagingMemory)
+        retireStaging();
+    
+    GenerationJob job;
+    {
+        lock_guard<mutex> lock(jobMutex);
+        if(!hasFinishedJob)
+            return;
+        swap(job, finishedJob);
+        hasFinishedJob = false;
+    }
+    
+    // something newer has been asked for since the worker picked this one up
+    if(job.id != requestedJob) {
+        releaseStaging(job.staged);
+        return;
+    }
+    // a coarse pass of an image leaves the worker still going on the rest
+    bool finished = job.stride <= 1;
+    if(finished)
+        jobLevel = -1;
+    if(finished && !job.stepped && !job.reused)
+        recordGenerateTime(job.scene, job.level, job.width, job.height, job.generateMs);
+    
+    // generation happened on the worker, but it's charged to the frame that shows it
+    currentFrame->ms[STAGE::GENERATE] = job.generateMs;
+    currentFrame->generated = job.points.size() + job.rgba.size()/4;
+    currentFrame->skipped = job.skipped;
+    currentFrame->antialiased = job.antialiased;
+    lastSkipped = job.skipped;
+    lastAntialiased = job.antialiased;
+    double start = profileTime();
+    
+    if(job.stepped) {
+        // the entry we stepped from has to still be there and unchanged, otherwise try again
+        CacheEntry* entry = findCacheEntry(job.scene, job.baseLevel, job.width, job.height, job.view);
+        if(!entry) {
+            releaseStaging(job.staged);
+            return;
+        }
+        
+        if(job.baseOffset == 0) {
+            entry->points.swap(job.points);
+            entry->colors.swap(job.colors);
+        }
+        else {
+            entry->points.resize(job.baseOffset);
+            entry->colors.resize(job.baseOffset);
+            entry->points.insert(entry->points.end(), job.points.begin(), job.points.end());
+            entry->colors.insert(entry->colors.end(), job.colors.begin(), job.colors.end());
+        }
+        
+        // the entry now holds the new level
+        rekeyCacheEntry(entry, job.level);
+        loadBuffer(*entry, job.firstChanged, job.packed, job.staged);
+        profileStage(STAGE::UPLOAD, start);
+        updateCacheBytes(*entry);
+        evictCache(cacheBudget);
+        return;
+    }
+    
+    // the passes after the first go into the texture the first one made, unless
+    // it already shows something finer (left over from a pass that got cancelled)
+    CacheEntry* previous = findCacheEntry(job.scene, job.level, job.width, job.height, job.view);
+    if(previous && previous->texture) {
+        if(job.stride < previous->stride) {
+            loadTexture(*previous, job.rgba);
+            previous->stride = job.stride;
         }
+        profileStage(STAGE::UPLOAD, start);
+        return;
     }
+    
+    geometryCache.push_front(CacheEntry());
+    CacheEntry& entry = geometryCache.front();
+    entry.scene = job.scene;
+    entry.level = job.level;
+    entry.width = job.width;
+    entry.height = job.height;
+    entry.mode = job.mode;
+    entry.count = job.points.size();
+    entry.capacity = 0;
+    entry.bytes = 0;
+    entry.texture = 0;
+    entry.stride = job.stride;
+    entry.view = job.view;
+    
+    if(findScene(job.scene)->image) {
+        // an image only needs an empty vertex array to draw from and its texture
+        glGenVertexArrays(1, &entry.vao);
+        for(int i=0; i<VBO::COUNT; i++)
+            entry.vbo[i] = 0;
+        entry.count = 4;
+        loadTexture(entry, job.rgba);
+        profileStage(STAGE::UPLOAD, start);
+        
+        updateCacheBytes(entry);
+        evictCache(cacheBudget);
+        return;
+    }
+    
+    // the entry takes ownership of the generated vertices
+    entry.points.swap(job.points);
+    entry.colors.swap(job.colors);
+    
+    generateIDs(entry.vao, entry.vbo);
+    initVAO(entry.vao, entry.vbo);
+    loadBuffer(entry, 0, job.packed, job.staged);
+    profileStage(STAGE::UPLOAD, start);
+    
+    updateCacheBytes(entry);
+    evictCache(cacheBudget);
 }
 
 // Initialization
 void initGL()
 {
     // Only call these once - don't call again every time you change geometry
-    generateIDs();		// Create VertexArrayObjects and Vertex Buffer Objects and store their handles
     initShader();		// Create shader and store program ID
-
-    initVAO();			// Describe setup of Vertex Array Objects and Vertex Buffer Objects
 }
 
 // Draws buffers to screen
@@ -623,45 +1505,116 @@ void render()
     
     // Don't need to call these on every draw, so long as they don't change
     glUseProgram(shader[SHADER::LINE]);		// Use LINE program
-    glBindVertexArray(vao[VAO::LINES]);		// Use the LINES vertex array
     
-    switch(scene){
-        case 1:
-            generateSquares(level);		// Create geometry - CHANGE THIS FOR DIFFERENT SCENES
-            loadBuffer(points, colors);
-            glDrawArrays(GL_LINES, 0, points.size()); // boxes and diamonds
-            break;
-        case 2:
-            generateSpiral(level);
-            loadBuffer(points, colors);
-            glDrawArrays(GL_LINE_STRIP, 0, points.size()); // spiral
-            break;
-        case 3:
-            generateSierpinski(level);
-            loadBuffer(points, colors);
-            glDrawArrays(GL_TRIANGLES, 0, points.size()); // sierpinski carpet
-            break;
-        case 4:
-            generateFern(level);
-            loadBuffer(points, colors);
-            glDrawArrays(GL_POINTS, 0, points.size()); // fern fractal
-            break;
-        case 5:
-            generateDragon(level);
-            loadBuffer(points, colors);
-            glDrawArrays(GL_LINE_STRIP, 0, points.size()); // dragon curve
-            break;
-        case 6:
-            generateMandelbrot(level);
-            loadBuffer(points, colors);
-            glDrawArrays(GL_POINTS, 0, points.size()); // mandelbrot set
-            break;
-        case 7:
-            generateJulia(level);
-            loadBuffer(points, colors);
-            glDrawArrays(GL_POINTS, 0, points.size()); // julia set
-            break;
+    // check what the level costs before doing any work for it
+    int drawLevel = admitLevel(scene, level, width, height);
+    updateSceneStatus(scene, level, drawLevel);
+    
+    // only generate and upload geometry when something actually changed
+    consumeFinishedJob();
+    if(drawLevel < 0) {
+        // turned down, so draw nothing rather than something the title doesn't match
+        cancelJob();
+        return;
+    }
+    CacheEntry* entry = findCacheEntry(scene, drawLevel, width, height, view);
+    if(!entry)
+        entry = truncateCacheEntry(scene, drawLevel, width, height);
+    if(entry && entry->stride <= 1)
+        cancelJob();
+    else
+        requestScene(scene, drawLevel, width, height, view);
+    
+    // until the worker is done keep showing whatever finished last
+    if(geometryCache.empty())
+        return;
+    entry = &geometryCache.front();
+    
+    if(entry->texture) {
+        glUseProgram(shader[SHADER::IMAGE]);
+        glBindTexture(GL_TEXTURE_2D, entry->texture);
     }
+    glBindVertexArray(entry->vao);          // Use the vertex array belonging to this scene
+    profiledDraw(entry->mode, entry->count);
+}
+
+
+
+
+// --------------------------------------------------------------------------
+// Headless rendering
+
+// runs a scene through the CPU rasterizer instead of OpenGL, so it works
+// without a GPU, a display or even a call to glfwInit()
+int renderHeadless(int scene, int level, int width, int height, const string& filename)
+{
+    vector<vec2> points;
+    vector<vec3> colors;
+    
+    // there's no picking a smaller level for someone who asked for this one exactly
+    const SceneInfo* info = findScene(scene);
+    if(!info) {
+        cout << "ERROR: There is no scene " << scene << endl;
+        return -1;
+    }
+    double bytes = info->image ? estimateImageBytes(scene, width, height) : estimateBytes(scene, level, width, height);
+    if(bytes > memoryBudget) {
+        cout << "ERROR: " << info->name << " level " << level << " needs about "
+             << (size_t)(bytes/(1024*1024)) << " MB, over the "
+             << (size_t)(memoryBudget/(1024*1024)) << " MB budget (raise it with --budget)" << endl;
+        return -1;
+    }
+    
+    double start = profileTime();
+    long long skipped = escapeSkippedIterations();
+    long long hits = tileStoreHits();
+    long long antialiased = escapeAntialiasSamples();
+    Image image(width, height);
+    double generated;
+    
+    if(info->image) {
+        // the same image the window puts in a texture, just flipped since image rows go top down
+        EscapeImage escape;
+        info->image(level, width, height, EscapeView(), 1, escape);
+        const vector<unsigned char>& rgba = escape.rgba;
+        generated = profileTime();
+        for(int y=0; y<height; y++) {
+            const unsigned char* texel = &rgba[4*(size_t)(height-1-y)*width];
+            unsigned char* pixel = &image.rgb[3*(size_t)y*width];
+            for(int x=0; x<width; x++, texel += 4, pixel += 3) {
+                pixel[0] = texel[0];
+                pixel[1] = texel[1];
+                pixel[2] = texel[2];
+            }
+        }
+    }
+    else {
+        int primitive = generateScene(scene, level, width, height, points, colors);
+        generated = profileTime();
+        rasterize(image, primitive, points, colors);
+    }
+    double rasterized = profileTime();
+    
+    if(!writeImage(image, filename)) {
+        cout << "ERROR: Could not write image to file " << filename << endl;
+        return -1;
+    }
+    
+    cout << "Scene " << scene << " level " << level << " at " << width << "x" << height << ": ";
+    if(info->image)
+        cout << (long)width*height << " pixels";
+    else
+        cout << points.size() << " vertices";
+    cout << ", generated in " << generated - start << " ms, rasterized in " << rasterized - generated << " ms";
+    if(escapeSkippedIterations() > skipped)
+        cout << ", skipped " << escapeSkippedIterations() - skipped << " iterations";
+    if(tileStoreHits() > hits)
+        cout << ", " << tileStoreHits() - hits << " pixels from the tile store";
+    if(escapeAntialiasSamples() > antialiased)
+        cout << ", antialiased with " << escapeAntialiasSamples() - antialiased << " extra samples ("
+             << (double)(escapeAntialiasSamples() - antialiased)/((double)width*height) << " per pixel)";
+    cout << endl;
+    return 0;
 }
 
 
@@ -672,6 +1625,82 @@ void render()
 
 int main(int argc, char *argv[])
 {
+    // --profile [file.csv] records per-stage frame timings
+    // --compact uploads 8-byte packed vertices instead of 20 bytes of floats
+    // --upload grow|orphan|persistent picks how vertices are streamed to the GPU
+    // --budget MB and --time-budget ms limit what a single scene may cost
+    // --threads N splits the Mandelbrot and Julia sets over N threads instead of one per core
+    // --subdivide fills in the Mandelbrot set by Mariani-Silver subdivision
+    // --antialias supersamples the pixels on the edges of the Mandelbrot and Julia sets and their bands
+    // --progressive [ms] shows the Mandelbrot and Julia sets coarse to fine, a pass every ms (16 by default)
+    // --tile-store file [MB] keeps the Mandelbrot and Julia sets' iterations in a file (512 MB by default) to reuse
+    // --headless <scene> <level> <width>x<height> <image.ppm|image.png> renders without a window
+    int headless = 0;
+    const char* storePath = 0;
+    double storeMegabytes = 512;
+    for(int i=1; i<argc; i++) {
+        if(string(argv[i]) == "--profile") {
+            profiling = true;
+            if(i+1 < argc && argv[i+1][0] != '-')
+                profilePath = argv[++i];
+        }
+        else if(string(argv[i]) == "--compact")
+            compactVertices = true;
+        else if(string(argv[i]) == "--upload" && i+1 < argc) {
+            string mode = argv[++i];
+            uploadMode = -1;
+            for(int m=0; m<UPLOAD::COUNT; m++) {
+                if(mode == uploadNames[m])
+                    uploadMode = m;
+            }
+            if(uploadMode < 0) {
+                cout << "usage: " << argv[0] << " --upload grow|orphan|persistent" << endl;
+                return -1;
+            }
+        }
+        else if(string(argv[i]) == "--budget" && i+1 < argc)
+            memoryBudget = atof(argv[++i])*1024*1024;
+        else if(string(argv[i]) == "--time-budget" && i+1 < argc)
+            timeBudget = atof(argv[++i]);
+        else if(string(argv[i]) == "--threads" && i+1 < argc)
+            generatorThreads = atoi(argv[++i]);
+        else if(string(argv[i]) == "--subdivide")
+            escapeSubdivide = true;
+        else if(string(argv[i]) == "--antialias")
+            escapeAntialias = true;
+        else if(string(argv[i]) == "--progressive") {
+            progressive = true;
+            if(i+1 < argc && argv[i+1][0] != '-')
+                frameTarget = std::max(1.0, atof(argv[++i]));
+        }
+        else if(string(argv[i]) == "--tile-store" && i+1 < argc) {
+            storePath = argv[++i];
+            if(i+1 < argc && argv[i+1][0] != '-')
+                storeMegabytes = atof(argv[++i]);
+        }
+        else if(string(argv[i]) == "--headless") {
+            headless = i;
+            i += 4;
+        }
+    }
+    
+    if(storePath && !openTileStore(storePath, storeMegabytes)) {
+        cout << "ERROR: Could not open the tile store " << storePath << endl;
+        return -1;
+    }
+    
+    if(headless) {
+        int w = 0;
+        int h = 0;
+        if(headless+4 >= argc || sscanf(argv[headless+3], "%dx%d", &w, &h) != 2 || w <= 0 || h <= 0) {
+            cout << "usage: " << argv[0] << " --headless <scene> <level> <width>x<height> <image.ppm|image.png>" << endl;
+            return -1;
+        }
+        int result = renderHeadless(atoi(argv[headless+1]), atoi(argv[headless+2]), w, h, argv[headless+4]);
+        closeTileStore();
+        return result;
+    }
+    
     // initialize the GLFW windowing system
     if (!glfwInit()) {
         cout << "ERROR: GLFW failed to initilize, TERMINATING" << endl;
@@ -694,28 +1723,50 @@ int main(int argc, char *argv[])
     
     // set keyboard callback function and make our context current (active)
     glfwSetKeyCallback(window, KeyCallback);
+    glfwSetMouseButtonCallback(window, MouseButtonCallback);
+    glfwSetCursorPosCallback(window, CursorPosCallback);
+    glfwSetScrollCallback(window, ScrollCallback);
+    glfwSetFramebufferSizeCallback(window, FramebufferSizeCallback);
     glfwMakeContextCurrent(window);
     
+    // the framebuffer can be larger than the window on high-DPI displays
+    glfwGetFramebufferSize(window, &width, &height);
+    
     // query and print out information about our OpenGL environment
     QueryGLVersion();
     
     initGL();
+    if(uploadMode == UPLOAD::PERSISTENT)
+        initStaging();
+    initProfiler();
+    startWorker();
     
     // run an event-triggered main loop
     while (!glfwWindowShouldClose(window))
     {
+        beginFrame();
+        
         // call function to draw our scene
         render();
         
         // scene is rendered to the back buffer, so swap to front for display
+        double start = profileTime();
         glfwSwapBuffers(window);
+        if(profiling)
+            profileStage(STAGE::SWAP, start);
+        endFrame(window);
         
         // sleep until next event before drawing again
         glfwWaitEvents();
     }
     
     // clean up allocated resources before exit
-    deleteIDs();
+    stopWorker();
+    closeTileStore();
+    dumpProfile();
+    clearCache();
+    deleteStaging();
+    deleteShaders();
     glfwDestroyWindow(window);
     glfwTerminate();
     
@@ -0,0 +1,246 @@
+// ==========================================================================
+// Buddhabrot sampler
+//
+// Modifications and additional functionality by Cameron Hardy (ID 10084560)
+// ==========================================================================
+
+#include "buddhabrot.h"
+#include "tilepool.h"
+
+#include <algorithm>
+#include <atomic>
+
+using namespace std;
+
+// c's are picked from the square |x|, |y| <= 2, since anything further out
+// escapes on its first iteration
+const double SAMPLE_RADIUS = 2.0;
+const int MAP_CELLS = 64;                   // the importance map is this many cells each way over the square
+const int MAP_PROBES = 4;                   // probed this many times each way
+const double MAP_FLOOR = 0.05;              // no cell is picked less than this much of the average, so none get left out
+const int CANCEL_POLL = 1024;               // orbits between checks for cancellation
+
+// --------------------------------------------------------------------------
+// Orbits
+
+// splitmix64, small and quick enough for every thread to have its own
+static inline unsigned long long nextRandom(unsigned long long& state)
+{
+    state += 0x9e3779b97f4a7c15ull;
+    unsigned long long z = state;
+    z = (z ^ (z >> 30))*0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27))*0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+// in [0, 1)
+static inline double uniformRandom(unsigned long long& state)
+{
+    return (nextRandom(state) >> 11)*(1.0/9007199254740992.0);
+}
+
+// inside the main cardioid or the period 2 bulb, so the orbit never escapes
+static inline bool mandelbrotInterior(double x, double y)
+{
+    double xq = x - 0.25;
+    double q = xq*xq + y*y;
+    double bulb = x + 1.0;
+    return q*(q + xq) <= 0.25*y*y || bulb*bulb + y*y <= 0.0625;
+}
+
+// how many iterations c's orbit takes to escape, or 0 if it doesn't within the level
+static int escapeTime(double cx, double cy, int level)
+{
+    if(mandelbrotInterior(cx, cy))
+        return 0;
+    double x = 0.0;
+    double y = 0.0;
+    for(int n=1; n<=level; n++) {
+        double xtemp = x*x - y*y + cx;
+        y = 2*x*y + cy;
+        x = xtemp;
+        if(x*x + y*y > 4.0)
+            return n;
+    }
+    return 0;
+}
+
+// how many points c's orbit puts in the histogram
+static int orbitLength(int orbits, double cx, double cy, int level)
+{
+    int escaped = escapeTime(cx, cy, level);
+    if(orbits == ORBITS::ESCAPING)
+        return escaped;
+    return escaped ? 0 : level;
+}
+
+// adds c's orbit up to iteration `steps` to the histogram, and its mirror image
+// (the orbit of c's conjugate) while it's at it. z1 is c itself, which would
+// only add a flat haze of wherever the c's were picked, so it's left out
+static void traceOrbit(double cx, double cy, int steps, float weight, const DensityGrid& grid, float* histogram)
+{
+    double toBinX = 1.0/grid.unitX;
+    double toBinY = 1.0/grid.unitY;
+    double x = 0.0;
+    double y = 0.0;
+    for(int n=0; n<steps; n++) {
+        double xtemp = x*x - y*y + cx;
+        y = 2*x*y + cy;
+        x = xtemp;
+        if(n == 0)
+            continue;                       // z1 = c
+
+        double u = (x - grid.left)*toBinX;
+        if(!(u >= 0.0 && u < grid.width))
+            continue;
+        size_t j = (size_t)u;
+        double v = (y - grid.bottom)*toBinY;
+        if(v >= 0.0 && v < grid.height)
+            histogram[(size_t)v*grid.width + j] += weight;
+        double mirror = (-y - grid.bottom)*toBinY;
+        if(mirror >= 0.0 && mirror < grid.height)
+            histogram[(size_t)mirror*grid.width + j] += weight;
+    }
+}
+
+// --------------------------------------------------------------------------
+// Importance map
+
+// How much a c adds to the picture goes by how long its orbit is, which is
+// worked out for a few c's in every cell of a coarse grid over the square. c's
+// are then picked by first picking a cell in proportion to that and then a
+// point in the cell evenly, and every orbit is weighted by the average of the
+// cells over its own cell's, which keeps the expected density exactly what
+// picking c's evenly gives.
+struct ImportanceMap {
+    int orbits;
+    int level;
+    vector<double> weight;                  // of every cell, row by row
+    vector<double> cumulative;              // running total of the weights
+    double average;
+
+    ImportanceMap() : orbits(-1), level(-1), average(0.0) {}
+};
+
+// only touched by whoever's making images, one at a time
+static ImportanceMap importance;
+
+static bool mapImportance(int orbits, int level, int threads, bool (*cancelled)())
+{
+    ImportanceMap& map = importance;
+    if(map.orbits == orbits && map.level == level)
+        return true;
+    map.orbits = -1;
+    map.weight.assign(MAP_CELLS*MAP_CELLS, 0.0);
+
+    double cell = 2*SAMPLE_RADIUS/MAP_CELLS;
+    atomic<bool> stopped(false);
+    runTiles(MAP_CELLS, threads, [&](int row) {
+        if(stopped || (cancelled && cancelled())) {
+            stopped = true;
+            return;
+        }
+        for(int column=0; column<MAP_CELLS; column++) {
+            double total = 0.0;
+            for(int a=0; a<MAP_PROBES; a++) {
+                for(int b=0; b<MAP_PROBES; b++) {
+                    double cx = -SAMPLE_RADIUS + cell*(column + (a + 0.5)/MAP_PROBES);
+                    double cy = -SAMPLE_RADIUS + cell*(row + (b + 0.5)/MAP_PROBES);
+                    total += orbitLength(orbits, cx, cy, level);
+                }
+            }
+            map.weight[row*MAP_CELLS + column] = total/(MAP_PROBES*MAP_PROBES);
+        }
+    });
+    if(stopped)
+        return false;
+
+    double average = 0.0;
+    for(size_t k=0; k<map.weight.size(); k++)
+        average += map.weight[k];
+    average /= map.weight.size();
+    map.cumulative.resize(map.weight.size());
+    double running = 0.0;
+    for(size_t k=0; k<map.weight.size(); k++) {
+        map.weight[k] = average > 0.0 ? std::max(map.weight[k], MAP_FLOOR*average) : 1.0;
+        running += map.weight[k];
+        map.cumulative[k] = running;
+    }
+    map.average = running/map.weight.size();
+    map.orbits = orbits;
+    map.level = level;
+    return true;
+}
+
+// --------------------------------------------------------------------------
+// Sampling
+
+// runs `samples` orbits into one thread's histogram, false if it noticed it was cancelled
+static bool sampleInto(const ImportanceMap& map, int level, const DensityGrid& grid, long long samples,
+                       unsigned long long state, float* histogram, bool (*cancelled)(), atomic<bool>& stopped)
+{
+    double cell = 2*SAMPLE_RADIUS/MAP_CELLS;
+    double total = map.cumulative.back();
+    for(long long s=0; s<samples; s++) {
+        if(s % CANCEL_POLL == 0 && (stopped || (cancelled && cancelled()))) {
+            stopped = true;
+            return false;
+        }
+
+        int k = (int)(upper_bound(map.cumulative.begin(), map.cumulative.end(), uniformRandom(state)*total) -
+                      map.cumulative.begin());
+        k = std::min(k, MAP_CELLS*MAP_CELLS - 1);
+        double cx = -SAMPLE_RADIUS + cell*(k%MAP_CELLS + uniformRandom(state));
+        double cy = -SAMPLE_RADIUS + cell*(k/MAP_CELLS + uniformRandom(state));
+        int steps = orbitLength(map.orbits, cx, cy, level);
+        if(steps > 0)
+            traceOrbit(cx, cy, steps, (float)(map.average/map.weight[k]), grid, histogram);
+    }
+    return true;
+}
+
+bool sampleOrbits(int orbits, int level, const DensityGrid& grid, long long samples, unsigned int seed,
+                  int threads, vector<float>& density, bool (*cancelled)())
+{
+    size_t bins = (size_t)grid.width*grid.height;
+    density.resize(bins, 0.0f);
+    if(bins == 0 || samples <= 0 || level <= 0)
+        return true;
+    threads = tileThreads(threads);
+    if(!mapImportance(orbits, level, threads, cancelled))
+        return false;
+
+    // one histogram per thread, so adding to them needs no synchronization
+    vector<vector<float> > histograms(threads);
+    atomic<bool> stopped(false);
+    runTiles(threads, threads, [&](int k) {
+        histograms[k].assign(bins, 0.0f);
+        long long share = samples/threads + (k < samples%threads ? 1 : 0);
+        unsigned long long state = ((unsigned long long)seed << 32) ^ (unsigned long long)k*0x632be59bd9b4e019ull;
+        sampleInto(importance, level, grid, share, state, histograms[k].data(), cancelled, stopped);
+    });
+    if(stopped)
+        return false;
+
+    // added up pairwise, log2(threads) rounds of adding one histogram into another,
+    // with each round split into bands of rows so every thread has some of it
+    int bands = threads;
+    for(int step=1; step<threads; step*=2) {
+        vector<int> firsts;
+        for(int k=0; k+step<threads; k += 2*step)
+            firsts.push_back(k);
+        runTiles((int)firsts.size()*bands, threads, [&](int task) {
+            float* into = histograms[firsts[task/bands]].data();
+            const float* from = histograms[firsts[task/bands] + step].data();
+            size_t begin = bins*(task%bands)/bands;
+            size_t end = bins*(task%bands + 1)/bands;
+            for(size_t b=begin; b<end; b++)
+                into[b] += from[b];
+        });
+    }
+
+    const float* sum = histograms[0].data();
+    for(size_t b=0; b<bins; b++)
+        density[b] += sum[b];
+    return true;
+}
@@ -0,0 +1,47 @@
+// ==========================================================================
+// Buddhabrot sampler
+//
+// The Buddhabrot is a density plot of the orbits of the Mandelbrot set: pick
+// points c, iterate z = z^2 + c from 0, and for every c whose orbit escapes
+// add one to every pixel the orbit went through. The anti-Buddhabrot does the
+// same with the orbits that never escape. It takes a great many orbits to
+// come out smooth, so they're spread over every core, each thread adding into
+// its own histogram (no locks or atomics in the loop), and the histograms are
+// added together pairwise in a tree at the end. Most c's either escape
+// straight away or never do, and add next to nothing to the Buddhabrot, so
+// c's are picked from a coarse map of where the orbits that matter start
+// (near the edge of the set) and weighted to make up for it.
+//
+// Modifications and additional functionality by Cameron Hardy (ID 10084560)
+// ==========================================================================
+
+#ifndef BUDDHABROT_H
+#define BUDDHABROT_H
+
+#include <vector>
+
+// which orbits go in the histogram
+// ESCAPING is the Buddhabrot, TRAPPED the anti-Buddhabrot
+struct ORBITS{
+    enum {ESCAPING=0, TRAPPED, COUNT};
+};
+
+// where the histogram's bins are on the plane: bin (j, i) covers
+// [left + j*unitX, left + (j+1)*unitX) x [bottom + i*unitY, bottom + (i+1)*unitY)
+struct DensityGrid {
+    int width;
+    int height;
+    double left;
+    double bottom;
+    double unitX;
+    double unitY;
+};
+
+// adds the orbits of `samples` c's (of up to `level` iterations) into density,
+// width*height bins row by row, weighted so it comes out as if the c's had been
+// picked evenly. seed picks which c's. Returns false (with density left alone)
+// if cancelled, which is polled every so often and may be null
+bool sampleOrbits(int orbits, int level, const DensityGrid& grid, long long samples, unsigned int seed,
+                  int threads, std::vector<float>& density, bool (*cancelled)());
+
+#endif
@@ -0,0 +1,325 @@
+// ==========================================================================
+// Deep zoom
+//
+// Modifications and additional functionality by Cameron Hardy (ID 10084560)
+// ==========================================================================
+
+#include "deepzoom.h"
+#include "escapetime.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// --------------------------------------------------------------------------
+// Fixed point
+
+DeepFixed::DeepFixed() {
+    memset(limb, 0, sizeof(limb));
+}
+
+static bool deepNegative(const DeepFixed& a) {
+    return (a.limb[0] & 0x80000000u) != 0;
+}
+
+static DeepFixed deepNegate(const DeepFixed& a) {
+    DeepFixed r;
+    unsigned long long carry = 1;
+    for(int k=DEEP_LIMBS-1; k>=0; k--) {
+        unsigned long long t = (unsigned long long)(~a.limb[k]) + carry;
+        r.limb[k] = (unsigned int)t;
+        carry = t >> 32;
+    }
+    return r;
+}
+
+DeepFixed deepFromDouble(double v) {
+    DeepFixed r;
+    double magnitude = fabs(v);
+    double whole = floor(magnitude);
+    r.limb[0] = (unsigned int)whole;
+    double fraction = magnitude - whole;
+    // a double only has 53 bits, so this runs out after a few limbs
+    for(int k=1; k<DEEP_LIMBS && fraction > 0.0; k++) {
+        fraction = ldexp(fraction, 32);
+        double digit = floor(fraction);
+        r.limb[k] = (unsigned int)digit;
+        fraction -= digit;
+    }
+    return v < 0.0 ? deepNegate(r) : r;
+}
+
+double deepToDouble(const DeepFixed& a) {
+    if(deepNegative(a))
+        return -deepToDouble(deepNegate(a));
+    // the first three limbs from the first that isn't zero are plenty for a double
+    int first = 0;
+    while(first < DEEP_LIMBS && a.limb[first] == 0)
+        first++;
+    double v = 0.0;
+    for(int k=std::min(first + 2, DEEP_LIMBS - 1); k>=first; k--)
+        v += ldexp((double)a.limb[k], -32*k);
+    return v;
+}
+
+DeepFixed deepAdd(const DeepFixed& a, const DeepFixed& b) {
+    DeepFixed r;
+    unsigned long long carry = 0;
+    for(int k=DEEP_LIMBS-1; k>=0; k--) {
+        unsigned long long t = (unsigned long long)a.limb[k] + b.limb[k] + carry;
+        r.limb[k] = (unsigned int)t;
+        carry = t >> 32;
+    }
+    return r;
+}
+
+DeepFixed deepSub(const DeepFixed& a, const DeepFixed& b) {
+    return deepAdd(a, deepNegate(b));
+}
+
+// Schoolbook on the magnitudes. Limbs i and j multiply into limb i+j of the
+// result, and everything past the last limb is dropped, so the products that
+// only land out there aren't worked out at all (that costs a few units in the
+// last limb, which is way below a pixel)
+DeepFixed deepMul(const DeepFixed& a, const DeepFixed& b) {
+    bool negative = deepNegative(a) != deepNegative(b);
+    DeepFixed x = deepNegative(a) ? deepNegate(a) : a;
+    DeepFixed y = deepNegative(b) ? deepNegate(b) : b;
+
+    // product[q] holds the limb worth 2^(-32*(q - 1)), so product[1] is the integer part
+    unsigned int product[DEEP_LIMBS + 1];
+    memset(product, 0, sizeof(product));
+    for(int i=DEEP_LIMBS-1; i>=0; i--) {
+        if(x.limb[i] == 0)
+            continue;
+        unsigned long long carry = 0;
+        for(int j=DEEP_LIMBS-1-i; j>=0; j--) {
+            unsigned long long t = (unsigned long long)x.limb[i]*y.limb[j] + product[i + j + 1] + carry;
+            product[i + j + 1] = (unsigned int)t;
+            carry = t >> 32;
+        }
+        product[i] += (unsigned int)carry;
+    }
+
+    DeepFixed r;
+    memcpy(r.limb, product + 1, sizeof(r.limb));
+    return negative ? deepNegate(r) : r;
+}
+
+bool deepEqual(const DeepFixed& a, const DeepFixed& b) {
+    return memcmp(a.limb, b.limb, sizeof(a.limb)) == 0;
+}
+
+// --------------------------------------------------------------------------
+// Reference orbit
+
+// iterates z = z^2 + c from z in fixed point, until it escapes or the level runs out
+static bool iterateOrbit(DeepFixed zx, DeepFixed zy, const DeepFixed& cx, const DeepFixed& cy, int level,
+                         std::vector<double>& orbitX, std::vector<double>& orbitY, bool (*cancelled)()) {
+    orbitX.clear();
+    orbitY.clear();
+    for(int n=0; ; n++) {
+        double rx = deepToDouble(zx);
+        double ry = deepToDouble(zy);
+        orbitX.push_back(rx);
+        orbitY.push_back(ry);
+        // always at least one step, so a pixel rebased onto the orbit has somewhere to go
+        if(n >= level || (n > 0 && rx*rx + ry*ry >= 4.0))
+            break;
+        if(cancelled && (n & 1023) == 1023 && cancelled())
+            return false;
+
+        // z^2 + c with two multiplies, (x + y)(x - y) and 2xy
+        DeepFixed real = deepAdd(deepMul(deepAdd(zx, zy), deepSub(zx, zy)), cx);
+        DeepFixed twice = deepMul(zx, zy);
+        zy = deepAdd(deepAdd(twice, twice), cy);
+        zx = real;
+    }
+    return true;
+}
+
+bool referenceOrbit(ReferenceOrbit& orbit, int formula, int level, const DeepFixed& x, const DeepFixed& y,
+                    double juliaX, double juliaY, bool (*cancelled)()) {
+    orbit.formula = formula;
+    orbit.level = level;
+    orbit.x = x;
+    orbit.y = y;
+    orbit.criticalX.clear();
+    orbit.criticalY.clear();
+
+    // the same starting point and constant as the float kernel
+    if(formula == ESCAPE::MANDELBROT)
+        return iterateOrbit(DeepFixed(), DeepFixed(), x, y, level, orbit.zx, orbit.zy, cancelled);
+
+    DeepFixed cx = deepFromDouble(juliaX);
+    DeepFixed cy = deepFromDouble(juliaY);
+    return iterateOrbit(x, y, cx, cy, level, orbit.zx, orbit.zy, cancelled) &&
+           iterateOrbit(DeepFixed(), DeepFixed(), cx, cy, level, orbit.criticalX, orbit.criticalY, cancelled);
+}
+
+// --------------------------------------------------------------------------
+// Perturbation
+
+// With the pixel at z = Z + d for the reference's Z, z^2 + c = Z^2 + c + (2Z + d)d
+// + dc, so d moves on to (2Z + d)d + dc where dc is how far the pixel's c is
+// from the reference's (nothing for the Julia set, where c is the same for
+// everybody).
+//
+// When |z| < |d| the pixel is near 0, where squaring shrinks everything and
+// the reference's orbit says little about the pixel's, so it's rebased: from
+// there on it's z = W + d against the orbit W of 0 (which is the Mandelbrot
+// set's reference anyway), starting with d = z. Rebasing when the reference
+// it's following ends (because the reference escaped) works the same way.
+//
+// A few pixels are iterated side by side in lanes, laid out so the compiler
+// can do the arithmetic for all of them at once (it's the same loop for every
+// lane, only the orbit is looked up at each lane's own iteration). A lane picks
+// up the next pixel as soon as its own is done. Lanes only have to be looked at
+// one by one when something happens: a pixel escaping, running out of
+// iterations or needing a rebase, and the last two can be seen coming, so the
+// lanes step together in bursts until the first of them is due.
+const int PERTURB_LANES = 4;
+
+struct PerturbLanes {
+    int pixel[PERTURB_LANES];               // -1 once there's nothing left for it
+    int remaining[PERTURB_LANES];
+    const double* ox[PERTURB_LANES];        // the orbit it's following
+    const double* oy[PERTURB_LANES];
+    int last[PERTURB_LANES];                // and its last iteration
+    int m[PERTURB_LANES];                   // how far along it the lane is
+    double ex[PERTURB_LANES];               // and how far off it
+    double ey[PERTURB_LANES];
+    double cx[PERTURB_LANES];               // how far its c is from the reference's
+    double cy[PERTURB_LANES];
+};
+
+static void startLane(PerturbLanes& lanes, int k, int pixel, const ReferenceOrbit& orbit, const double* dx, const double* dy)
+{
+    lanes.pixel[k] = pixel;
+    lanes.remaining[k] = orbit.level;
+    lanes.ox[k] = orbit.zx.data();
+    lanes.oy[k] = orbit.zy.data();
+    lanes.last[k] = (int)orbit.zx.size() - 1;
+    lanes.m[k] = 0;
+    // the Mandelbrot set starts every pixel at 0 like the reference, the Julia
+    // set starts them where they are
+    bool mandelbrot = orbit.formula == ESCAPE::MANDELBROT;
+    lanes.ex[k] = mandelbrot ? 0.0 : dx[pixel];
+    lanes.ey[k] = mandelbrot ? 0.0 : dy[pixel];
+    lanes.cx[k] = mandelbrot ? dx[pixel] : 0.0;
+    lanes.cy[k] = mandelbrot ? dy[pixel] : 0.0;
+}
+
+// one iteration of one lane with every check, returns false (with its level
+// written) once the lane's pixel is done
+static bool stepLane(PerturbLanes& lanes, int k, const ReferenceOrbit& orbit, int* levels)
+{
+    double x = lanes.ox[k][lanes.m[k]] + lanes.ex[k];
+    double y = lanes.oy[k][lanes.m[k]] + lanes.ey[k];
+    if(lanes.remaining[k] == 0 || x*x + y*y >= 4.0) {
+        levels[lanes.pixel[k]] = lanes.remaining[k];
+        return false;
+    }
+
+    if(x*x + y*y < lanes.ex[k]*lanes.ex[k] + lanes.ey[k]*lanes.ey[k] || lanes.m[k] == lanes.last[k]) {
+        bool mandelbrot = orbit.formula == ESCAPE::MANDELBROT;
+        lanes.ox[k] = mandelbrot ? orbit.zx.data() : orbit.criticalX.data();
+        lanes.oy[k] = mandelbrot ? orbit.zy.data() : orbit.criticalY.data();
+        lanes.last[k] = (int)(mandelbrot ? orbit.zx.size() : orbit.criticalX.size()) - 1;
+        lanes.ex[k] = x;
+        lanes.ey[k] = y;
+        lanes.m[k] = 0;
+    }
+
+    double zx = lanes.ox[k][lanes.m[k]];
+    double zy = lanes.oy[k][lanes.m[k]];
+    double ax = zx + zx + lanes.ex[k];
+    double ay = zy + zy + lanes.ey[k];
+    double nx = ax*lanes.ex[k] - ay*lanes.ey[k] + lanes.cx[k];
+    lanes.ey[k] = ax*lanes.ey[k] + ay*lanes.ex[k] + lanes.cy[k];
+    lanes.ex[k] = nx;
+    lanes.m[k]++;
+    lanes.remaining[k]--;
+    return true;
+}
+
+// steps every lane until one escapes or needs a rebase, or `burst` iterations
+// are up, and returns how many iterations that was
+static int burstLanes(PerturbLanes& lanes, int burst)
+{
+    int n = 0;
+    for(; n<burst; n++) {
+        double zx[PERTURB_LANES];
+        double zy[PERTURB_LANES];
+        for(int k=0; k<PERTURB_LANES; k++) {
+            zx[k] = lanes.ox[k][lanes.m[k] + n];
+            zy[k] = lanes.oy[k][lanes.m[k] + n];
+        }
+
+        long long due[PERTURB_LANES];
+        for(int k=0; k<PERTURB_LANES; k++) {
+            double x = zx[k] + lanes.ex[k];
+            double y = zy[k] + lanes.ey[k];
+            double r = x*x + y*y;
+            due[k] = (r >= 4.0) | (r < lanes.ex[k]*lanes.ex[k] + lanes.ey[k]*lanes.ey[k]);
+        }
+        long long attention = 0;
+        for(int k=0; k<PERTURB_LANES; k++)
+            attention |= due[k];
+        if(attention)
+            break;
+
+        for(int k=0; k<PERTURB_LANES; k++) {
+            double ax = zx[k] + zx[k] + lanes.ex[k];
+            double ay = zy[k] + zy[k] + lanes.ey[k];
+            double nx = ax*lanes.ex[k] - ay*lanes.ey[k] + lanes.cx[k];
+            lanes.ey[k] = ax*lanes.ey[k] + ay*lanes.ex[k] + lanes.cy[k];
+            lanes.ex[k] = nx;
+        }
+    }
+
+    for(int k=0; k<PERTURB_LANES; k++) {
+        lanes.m[k] += n;
+        lanes.remaining[k] -= n;
+    }
+    return n;
+}
+
+void perturbPoints(const ReferenceOrbit& orbit, const double* dx, const double* dy, int count, int* levels) {
+    PerturbLanes lanes;
+    int next = 0;
+    for(int k=0; k<PERTURB_LANES; k++) {
+        lanes.pixel[k] = -1;
+        if(next < count)
+            startLane(lanes, k, next++, orbit, dx, dy);
+    }
+
+    bool full = count >= PERTURB_LANES;
+    while(full) {
+        // until the first lane runs out of iterations or reaches the end of its orbit
+        int burst = orbit.level;
+        for(int k=0; k<PERTURB_LANES; k++)
+            burst = std::min(burst, std::min(lanes.remaining[k], lanes.last[k] - lanes.m[k]));
+        burstLanes(lanes, burst);
+
+        // then one step the slow way for whoever's due
+        for(int k=0; k<PERTURB_LANES; k++) {
+            if(stepLane(lanes, k, orbit, levels))
+                continue;
+            if(next < count)
+                startLane(lanes, k, next++, orbit, dx, dy);
+            else {
+                lanes.pixel[k] = -1;
+                full = false;
+            }
+        }
+    }
+
+    // the last few pixels, once there aren't enough to go round
+    for(int k=0; k<PERTURB_LANES; k++) {
+        if(lanes.pixel[k] >= 0) {
+            while(stepLane(lanes, k, orbit, levels))
+                ;
+        }
+    }
+}
@@ -0,0 +1,70 @@
+// ==========================================================================
+// Deep zoom
+//
+// Floats run out of digits about 1000x into the Mandelbrot set, when
+// neighbouring pixels stop having different coordinates. Going deeper uses
+// perturbation: one reference point near the middle of the view is iterated
+// in fixed point with a few hundred bits, and every pixel only iterates how
+// far its orbit is from the reference's (a tiny delta that a double holds
+// fine) against that. When a pixel's orbit wanders closer to 0 than to where
+// the reference has got to, the delta can't keep up and would come out wrong
+// (a glitch), so it's rebased onto the orbit of 0 (the start of the reference
+// orbit for the Mandelbrot set) and carries on from there.
+//
+// Modifications and additional functionality by Cameron Hardy (ID 10084560)
+// ==========================================================================
+
+#ifndef DEEPZOOM_H
+#define DEEPZOOM_H
+
+#include <vector>
+
+// A fixed point number, limb 0 is the integer part and the rest are the
+// fraction 32 bits at a time, all of it two's complement. 448 bits of
+// fraction is enough for pixels down to about 1e-130
+const int DEEP_LIMBS = 15;
+
+struct DeepFixed {
+    unsigned int limb[DEEP_LIMBS];
+
+    DeepFixed();
+};
+
+DeepFixed deepFromDouble(double v);
+double deepToDouble(const DeepFixed& a);
+DeepFixed deepAdd(const DeepFixed& a, const DeepFixed& b);
+DeepFixed deepSub(const DeepFixed& a, const DeepFixed& b);
+DeepFixed deepMul(const DeepFixed& a, const DeepFixed& b);
+bool deepEqual(const DeepFixed& a, const DeepFixed& b);
+
+// the zoom past which the escape-time sets switch to perturbation, and the
+// deepest they go before the fixed point runs out
+const double DEEP_ZOOM = 1000.0;
+const double DEEP_MAX_ZOOM = 1.0e120;
+
+// The orbit of the reference point, worked out in fixed point and rounded to
+// doubles, up to the iteration it escaped at or the level
+struct ReferenceOrbit {
+    int formula;                            // ESCAPE formula
+    int level;
+    DeepFixed x;                            // the reference point
+    DeepFixed y;
+    std::vector<double> zx;                 // z at every iteration, starting with z0
+    std::vector<double> zy;
+    std::vector<double> criticalX;          // the orbit of 0 for the Julia set (the Mandelbrot
+    std::vector<double> criticalY;          // set's reference orbit already is one)
+
+    ReferenceOrbit() : formula(-1), level(0) {}
+};
+
+// iterates the reference orbit of (x, y), with c = juliaX + juliaY i for the
+// Julia set; returns false (with the orbit unfinished) if cancelled, which is
+// polled every so often and may be null
+bool referenceOrbit(ReferenceOrbit& orbit, int formula, int level, const DeepFixed& x, const DeepFixed& y,
+                    double juliaX, double juliaY, bool (*cancelled)());
+
+// iterates `count` pixels at (dx[j], dy[j]) from the reference point and writes
+// how many iterations each one had left to levels[j], the same as escapePoints
+void perturbPoints(const ReferenceOrbit& orbit, const double* dx, const double* dy, int count, int* levels);
+
+#endif
@@ -0,0 +1,568 @@
+// ==========================================================================
+// Escape-time kernel
+//
+// Modifications and additional functionality by Cameron Hardy (ID 10084560)
+// ==========================================================================
+
+#include "escapetime.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <complex>
+#include "glm/glm.hpp"                      // for GLM_ARCH, see glm/simd/platform.h
+
+#if GLM_ARCH & GLM_ARCH_AVX2_BIT
+#include <immintrin.h>
+#elif GLM_ARCH & GLM_ARCH_SSE2_BIT
+#include <emmintrin.h>
+#endif
+
+// --------------------------------------------------------------------------
+// Interior checks
+
+// Pixels inside the set never escape, so without help they burn every one of
+// the `level` iterations. Two things let them stop early:
+//  - The main cardioid and the period 2 bulb of the Mandelbrot set have closed
+//    forms, so pixels in there are done before the first iteration.
+//  - Everywhere else (and for the other formulas) the orbit of an interior
+//    pixel settles into a cycle. Brent's algorithm remembers where the orbit
+//    was at iteration 1, 2, 4, 8, ... and if it comes back to within TOLERANCE
+//    of there the pixel is done. That also covers the old exact fixed point check.
+// Either way the pixel gets 0 left, same as if it had run out of iterations.
+const float TOLERANCE = 1.0e-6f;
+
+static std::atomic<long long> skippedIterations(0);
+
+long long escapeSkippedIterations()
+{
+    return skippedIterations.load(std::memory_order_relaxed);
+}
+
+// inside the main cardioid or the period 2 bulb
+static inline bool mandelbrotInterior(float x, float y)
+{
+    float xq = x - 0.25f;
+    float q = xq*xq + y*y;
+    float bulb = x + 1.0f;
+    return q*(q + xq) <= 0.25f*y*y || bulb*bulb + y*y <= 0.0625f;
+}
+
+bool mandelbrotCardioid(float x, float y)
+{
+    return mandelbrotInterior(x, y);
+}
+
+// The interior distance estimate: once an orbit has settled onto an attracting
+// cycle z0 -> ... -> z0 of period p, with F = f^p and its derivatives taken at
+// z0, everything within (1 - |F_z|^2)/|F_cz + F_zz F_c/(1 - F_z)| / 4 of c is
+// inside the set too. The cycle is found with Brent's algorithm again (in
+// doubles, and much tighter than TOLERANCE), pulled onto z0 exactly by Newton's
+// method on F(z) = z, and cut down to its smallest period before the
+// derivatives are taken, since the estimate only holds for that.
+const double CYCLE_TOLERANCE = 1.0e-10;
+const int CYCLE_NEWTON = 4;                 // Newton steps from where Brent's algorithm stopped
+
+double mandelbrotInteriorRadius(double x, double y, int level)
+{
+    typedef std::complex<double> Complex;
+    Complex c(x, y);
+    Complex z(0.0, 0.0);
+    Complex saved = z;
+    int period = 0;
+    for(int n=0, power=1, steps=0; n<level && !period; n++) {
+        z = z*z + c;
+        if(std::norm(z) > 4.0)
+            return 0.0;
+        steps++;
+        if(std::abs(z - saved) < CYCLE_TOLERANCE)
+            period = steps;
+        else if(steps == power) {
+            saved = z;
+            power *= 2;
+            steps = 0;
+        }
+    }
+    if(!period)
+        return 0.0;
+    
+    for(int k=0; k<CYCLE_NEWTON; k++) {
+        Complex w = z;
+        Complex dz(1.0, 0.0);
+        for(int p=0; p<period; p++) {
+            dz = 2.0*w*dz;
+            w = w*w + c;
+        }
+        if(dz == Complex(1.0, 0.0))
+            return 0.0;
+        z -= (w - z)/(dz - 1.0);
+    }
+    Complex w = z*z + c;
+    for(int p=1; p<period; p++, w = w*w + c) {
+        if(std::abs(w - z) < CYCLE_TOLERANCE) {
+            period = p;
+            break;
+        }
+    }
+    
+    Complex dz(1.0, 0.0);
+    Complex dc(0.0, 0.0);
+    Complex dzdz(0.0, 0.0);
+    Complex dcdz(0.0, 0.0);
+    for(int p=0; p<period; p++) {
+        dcdz = 2.0*(z*dcdz + dz*dc);
+        dzdz = 2.0*(z*dzdz + dz*dz);
+        dz = 2.0*z*dz;
+        dc = 2.0*z*dc + 1.0;
+        z = z*z + c;
+    }
+    double attraction = std::norm(dz);
+    if(!(attraction < 1.0))
+        return 0.0;
+    double radius = (1.0 - attraction)/std::abs(dcdz + dzdz*dc/(1.0 - dz))/4.0;
+    return std::isfinite(radius) ? radius : 0.0;
+}
+
+// --------------------------------------------------------------------------
+// Lane operations
+
+// The formulas and the kernel are written once in terms of these, for a float
+// and for whichever vector register the build has. The vector ones are as thin
+// as they look, so the kernel comes out the same as if it was written in
+// intrinsics. Masks are floats with every bit set in the lanes that are true.
+
+static inline float add(float a, float b) { return a + b; }
+static inline float sub(float a, float b) { return a - b; }
+static inline float mul(float a, float b) { return a*b; }
+static inline float absolute(float a) { return std::abs(a); }
+static inline float negate(float a) { return -a; }
+// (float)((double)v + c), the way the Julia set adds its constant
+static inline float addDouble(float v, double c) { return v + c; }
+
+#if GLM_ARCH & GLM_ARCH_AVX2_BIT
+
+const int WIDTH = 8;
+typedef __m256 Floats;
+typedef __m256d Doubles;
+typedef __m256i Ints;
+
+static inline Floats load(const float* p) { return _mm256_loadu_ps(p); }
+static inline Floats splat(float v) { return _mm256_set1_ps(v); }
+static inline Doubles splatDouble(double v) { return _mm256_set1_pd(v); }
+static inline Ints splatInt(int v) { return _mm256_set1_epi32(v); }
+static inline void store(int* p, Ints v) { _mm256_storeu_si256((__m256i*)p, v); }
+
+static inline Floats add(Floats a, Floats b) { return _mm256_add_ps(a, b); }
+static inline Floats sub(Floats a, Floats b) { return _mm256_sub_ps(a, b); }
+static inline Floats mul(Floats a, Floats b) { return _mm256_mul_ps(a, b); }
+static inline Floats absolute(Floats a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a); }
+static inline Floats negate(Floats a) { return _mm256_xor_ps(_mm256_set1_ps(-0.0f), a); }
+
+// (float)((double)v + c) in every lane
+static inline Floats addDouble(Floats v, Doubles c)
+{
+    __m256d low = _mm256_add_pd(_mm256_cvtps_pd(_mm256_castps256_ps128(v)), c);
+    __m256d high = _mm256_add_pd(_mm256_cvtps_pd(_mm256_extractf128_ps(v, 1)), c);
+    return _mm256_insertf128_ps(_mm256_castps128_ps256(_mm256_cvtpd_ps(low)), _mm256_cvtpd_ps(high), 1);
+}
+
+static inline Floats lessThan(Floats a, Floats b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+static inline Floats lessEqual(Floats a, Floats b) { return _mm256_cmp_ps(a, b, _CMP_LE_OQ); }
+static inline Floats both(Floats a, Floats b) { return _mm256_and_ps(a, b); }
+static inline Floats either(Floats a, Floats b) { return _mm256_or_ps(a, b); }
+static inline Floats unless(Floats mask, Floats a) { return _mm256_andnot_ps(mask, a); }
+static inline Floats select(Floats mask, Floats a, Floats b) { return _mm256_blendv_ps(b, a, mask); }
+static inline bool anyLane(Floats mask) { return _mm256_movemask_ps(mask) != 0; }
+// the first n lanes
+static inline Floats firstLanes(int n)
+{
+    return _mm256_castsi256_ps(_mm256_cmpgt_epi32(_mm256_set1_epi32(n), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7)));
+}
+
+// a mask as ints is -1 in its lanes, which is what counting them down needs
+static inline Ints maskBits(Floats mask) { return _mm256_castps_si256(mask); }
+static inline Ints addInts(Ints a, Ints b) { return _mm256_add_epi32(a, b); }
+static inline Ints keepInts(Floats mask, Ints a) { return _mm256_and_si256(_mm256_castps_si256(mask), a); }
+static inline Ints dropInts(Floats mask, Ints a) { return _mm256_andnot_si256(_mm256_castps_si256(mask), a); }
+
+const char* escapeKernelName() { return "AVX2"; }
+
+#elif GLM_ARCH & GLM_ARCH_SSE2_BIT
+
+const int WIDTH = 4;
+typedef __m128 Floats;
+typedef __m128d Doubles;
+typedef __m128i Ints;
+
+static inline Floats load(const float* p) { return _mm_loadu_ps(p); }
+static inline Floats splat(float v) { return _mm_set1_ps(v); }
+static inline Doubles splatDouble(double v) { return _mm_set1_pd(v); }
+static inline Ints splatInt(int v) { return _mm_set1_epi32(v); }
+static inline void store(int* p, Ints v) { _mm_storeu_si128((__m128i*)p, v); }
+
+static inline Floats add(Floats a, Floats b) { return _mm_add_ps(a, b); }
+static inline Floats sub(Floats a, Floats b) { return _mm_sub_ps(a, b); }
+static inline Floats mul(Floats a, Floats b) { return _mm_mul_ps(a, b); }
+static inline Floats absolute(Floats a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+static inline Floats negate(Floats a) { return _mm_xor_ps(_mm_set1_ps(-0.0f), a); }
+
+// (float)((double)v + c) in every lane
+static inline Floats addDouble(Floats v, Doubles c)
+{
+    __m128d low = _mm_add_pd(_mm_cvtps_pd(v), c);
+    __m128d high = _mm_add_pd(_mm_cvtps_pd(_mm_movehl_ps(v, v)), c);
+    return _mm_movelh_ps(_mm_cvtpd_ps(low), _mm_cvtpd_ps(high));
+}
+
+static inline Floats lessThan(Floats a, Floats b) { return _mm_cmplt_ps(a, b); }
+static inline Floats lessEqual(Floats a, Floats b) { return _mm_cmple_ps(a, b); }
+static inline Floats both(Floats a, Floats b) { return _mm_and_ps(a, b); }
+static inline Floats either(Floats a, Floats b) { return _mm_or_ps(a, b); }
+static inline Floats unless(Floats mask, Floats a) { return _mm_andnot_ps(mask, a); }
+// SSE2 has no blendv, so pick with and/andnot/or
+static inline Floats select(Floats mask, Floats a, Floats b) { return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b)); }
+static inline bool anyLane(Floats mask) { return _mm_movemask_ps(mask) != 0; }
+// the first n lanes
+static inline Floats firstLanes(int n)
+{
+    return _mm_castsi128_ps(_mm_cmpgt_epi32(_mm_set1_epi32(n), _mm_setr_epi32(0, 1, 2, 3)));
+}
+
+// a mask as ints is -1 in its lanes, which is what counting them down needs
+static inline Ints maskBits(Floats mask) { return _mm_castps_si128(mask); }
+static inline Ints addInts(Ints a, Ints b) { return _mm_add_epi32(a, b); }
+static inline Ints keepInts(Floats mask, Ints a) { return _mm_and_si128(_mm_castps_si128(mask), a); }
+static inline Ints dropInts(Floats mask, Ints a) { return _mm_andnot_si128(_mm_castps_si128(mask), a); }
+
+const char* escapeKernelName() { return "SSE2"; }
+
+#else
+
+const char* escapeKernelName() { return "scalar"; }
+
+#endif
+
+// --------------------------------------------------------------------------
+// Formulas
+
+// Every formula is a policy the kernels are instantiated with, so each one
+// gets a loop of its own with nothing about the formula left to decide per
+// pixel or per iteration. A formula says
+//  - POWER, what z is raised to,
+//  - JULIA, whether c is the constant juliaX + juliaY i and z starts at the
+//    pixel, or c is the pixel and z starts at 0,
+//  - CARDIOID, whether the Mandelbrot set's closed forms apply,
+//  - CONNECTED, whether its set is connected wherever the view is, so a
+//    border of one count has nothing else inside it (see subdivide in
+//    generators.cpp). The Julia set isn't once c leaves the Mandelbrot set,
+//    and the Burning Ship falls apart into pieces anyway,
+//  - PERTURBED, whether it's z^2 + c, so perturbation can take over past
+//    DEEP_ZOOM (the rest stay in floats and go blocky there),
+//  - frame(), where it sits on the plane,
+//  - fold(x, y), what's done to z before it's raised. It has to leave |z|
+//    alone, since whether z has escaped goes by z before the fold.
+// A new formula is a struct here and its line in ESCAPE_FORMULAS. Everything
+// past the kernel (tiles, coloring, the tile store, antialiasing) goes by the
+// formula.
+
+struct MandelbrotFormula {
+    enum {POWER=2, JULIA=0, CARDIOID=1, CONNECTED=1, PERTURBED=1};
+    static EscapeFrame frame() { EscapeFrame frame = {-2.5f, -1.5f}; return frame; }
+    template<class F> static inline void fold(F&, F&) {}
+};
+
+struct JuliaFormula {
+    enum {POWER=2, JULIA=1, CARDIOID=0, CONNECTED=0, PERTURBED=1};
+    static EscapeFrame frame() { EscapeFrame frame = {-1.75f, -1.5f}; return frame; }
+    template<class F> static inline void fold(F&, F&) {}
+};
+
+// (|x| + |y| i)^2 + c, with everything conjugated so the ship comes out the
+// right way up (it's usually drawn with the imaginary axis pointing down).
+// It's mostly above the axis, so it sits higher than the others
+struct BurningShipFormula {
+    enum {POWER=2, JULIA=0, CARDIOID=0, CONNECTED=0, PERTURBED=0};
+    static EscapeFrame frame() { EscapeFrame frame = {-2.25f, -0.95f}; return frame; }
+    template<class F> static inline void fold(F& x, F& y) { x = absolute(x); y = negate(absolute(y)); }
+};
+
+// conj(z)^2 + c
+struct TricornFormula {
+    enum {POWER=2, JULIA=0, CARDIOID=0, CONNECTED=0, PERTURBED=0};
+    static EscapeFrame frame() { EscapeFrame frame = {-2.3f, -1.5f}; return frame; }
+    template<class F> static inline void fold(F&, F& y) { y = negate(y); }
+};
+
+// z^3 + c
+struct MultibrotFormula {
+    enum {POWER=3, JULIA=0, CARDIOID=0, CONNECTED=0, PERTURBED=0};
+    static EscapeFrame frame() { EscapeFrame frame = {-1.75f, -1.5f}; return frame; }
+    template<class F> static inline void fold(F&, F&) {}
+};
+
+// one iteration, given the x*x and y*y the escape check already needed. The
+// square is x*x - y*y + 2xy i, and any higher power multiplies z back in
+template<class Formula, class F, class D>
+static inline void iterate(F x, F y, F xx, F yy, F cx, F cy, D juliaX, D juliaY, F& xtemp, F& ytemp)
+{
+    Formula::fold(x, y);
+    F real = sub(xx, yy);
+    F imag = mul(add(x, x), y);
+    for(int p=2; p<Formula::POWER; p++) {
+        F t = sub(mul(real, x), mul(imag, y));
+        imag = add(mul(real, y), mul(imag, x));
+        real = t;
+    }
+    if(Formula::JULIA) {
+        xtemp = addDouble(real, juliaX);
+        ytemp = addDouble(imag, juliaY);
+    }
+    else {
+        xtemp = add(real, cx);
+        ytemp = add(imag, cy);
+    }
+}
+
+// --------------------------------------------------------------------------
+// Kernels
+
+// one pixel with the interior checks, the way every vector lane does it
+// returns the iterations left and adds the ones it didn't have to do to skipped
+template<class Formula>
+static int escapePixel(int level, float x0, float y0, double juliaX, double juliaY, long& skipped)
+{
+    if(Formula::CARDIOID && mandelbrotInterior(x0, y0)) {
+        skipped += level;
+        return 0;
+    }
+    
+    float x = Formula::JULIA ? x0 : 0.0f;
+    float y = Formula::JULIA ? y0 : 0.0f;
+    float savedX = x;
+    float savedY = y;
+    float xtemp;
+    float ytemp;
+    int checkpoint = 1;
+    
+    int levelx = level;
+    for(int i=0; i<level && x*x + y*y < 4.0f; i++) {
+        iterate<Formula>(x, y, x*x, y*y, x0, y0, juliaX, juliaY, xtemp, ytemp);
+        if(std::abs(xtemp - savedX) <= TOLERANCE && std::abs(ytemp - savedY) <= TOLERANCE) {
+            skipped += levelx;
+            return 0;
+        }
+        x = xtemp;
+        y = ytemp;
+        levelx--;
+        if(i+1 == checkpoint) {
+            savedX = x;
+            savedY = y;
+            checkpoint *= 2;
+        }
+    }
+    return levelx;
+}
+
+#if GLM_ARCH & (GLM_ARCH_AVX2_BIT | GLM_ARCH_SSE2_BIT)
+
+// Every lane runs the same loop as escapePixel. Lanes that escape (or turn out
+// to be interior) are masked off and stop changing, and the whole group is
+// done once every lane is masked off or the level runs out. Each lane's count
+// of iterations left goes down by one per iteration it's still active, which
+// is just adding the all-ones (-1) active mask to it. All the lanes of a group
+// are on the same iteration, so they share Brent's checkpoints.
+//
+// One register on its own spends most of its time waiting on the multiply
+// before it, so REGISTERS of them are interleaved to keep the FPU busy.
+const int REGISTERS = 4;
+const int LANES = WIDTH*REGISTERS;
+
+template<class Formula>
+static long escapeLanes(int level, const float* x0, const float* y0, int count, int* levels, double cReal, double cImag)
+{
+    const Floats four = splat(4.0f);
+    const Floats tolerance = splat(TOLERANCE);
+    const Doubles juliaX = splatDouble(cReal);
+    const Doubles juliaY = splatDouble(cImag);
+    Floats cx[REGISTERS];
+    Floats cy[REGISTERS];
+    Floats x[REGISTERS];
+    Floats y[REGISTERS];
+    Floats savedX[REGISTERS];
+    Floats savedY[REGISTERS];
+    Floats active[REGISTERS];
+    Ints left[REGISTERS];
+    Ints skipped = splatInt(0);
+    for(int k=0; k<REGISTERS; k++) {
+        cx[k] = load(x0 + WIDTH*k);
+        cy[k] = load(y0 + WIDTH*k);
+        x[k] = Formula::JULIA ? cx[k] : splat(0.0f);
+        y[k] = Formula::JULIA ? cy[k] : splat(0.0f);
+        savedX[k] = x[k];
+        savedY[k] = y[k];
+        // lanes past count are padding and start out done
+        active[k] = firstLanes(count - WIDTH*k);
+        left[k] = keepInts(active[k], splatInt(level));
+        
+        if(Formula::CARDIOID) {
+            // mandelbrotInterior, a lane at a time
+            Floats xq = sub(cx[k], splat(0.25f));
+            Floats yy = mul(cy[k], cy[k]);
+            Floats q = add(mul(xq, xq), yy);
+            Floats bulb = add(cx[k], splat(1.0f));
+            Floats inside = either(lessEqual(mul(q, add(q, xq)), mul(splat(0.25f), yy)),
+                                   lessEqual(add(mul(bulb, bulb), yy), splat(0.0625f)));
+            skipped = addInts(skipped, keepInts(inside, left[k]));
+            left[k] = dropInts(inside, left[k]);
+            active[k] = unless(inside, active[k]);
+        }
+    }
+    
+    int checkpoint = 1;
+    for(int i=0; i<level; i++) {
+        Floats any = splat(0.0f);
+        for(int k=0; k<REGISTERS; k++) {
+            Floats xx = mul(x[k], x[k]);
+            Floats yy = mul(y[k], y[k]);
+            active[k] = both(active[k], lessThan(add(xx, yy), four));
+            
+            Floats xtemp;
+            Floats ytemp;
+            iterate<Formula>(x[k], y[k], xx, yy, cx[k], cy[k], juliaX, juliaY, xtemp, ytemp);
+            
+            // a lane back where it was at the last checkpoint is in a cycle and never escapes
+            Floats dx = absolute(sub(xtemp, savedX[k]));
+            Floats dy = absolute(sub(ytemp, savedY[k]));
+            Floats cycle = both(both(lessEqual(dx, tolerance), lessEqual(dy, tolerance)), active[k]);
+            skipped = addInts(skipped, keepInts(cycle, left[k]));
+            left[k] = dropInts(cycle, left[k]);
+            active[k] = unless(cycle, active[k]);
+            
+            x[k] = select(active[k], xtemp, x[k]);
+            y[k] = select(active[k], ytemp, y[k]);
+            left[k] = addInts(left[k], maskBits(active[k]));
+            any = either(any, active[k]);
+        }
+        if(!anyLane(any))
+            break;
+        
+        if(i+1 == checkpoint) {
+            for(int k=0; k<REGISTERS; k++) {
+                savedX[k] = x[k];
+                savedY[k] = y[k];
+            }
+            checkpoint *= 2;
+        }
+    }
+    
+    for(int k=0; k<REGISTERS; k++)
+        store(levels + WIDTH*k, left[k]);
+    
+    int lanes[WIDTH];
+    store(lanes, skipped);
+    long total = 0;
+    for(int k=0; k<WIDTH; k++)
+        total += (unsigned int)lanes[k];
+    return total;
+}
+
+// up to LANES pixels through escapeLanes
+template<class Formula>
+static long escapeChunk(int level, const float* x0, const float* y0, int count, int* levels,
+                        double juliaX, double juliaY)
+{
+    if(count == LANES)
+        return escapeLanes<Formula>(level, x0, y0, LANES, levels, juliaX, juliaY);
+    
+    // a short chunk (like the end of a row) is copied somewhere that can be read
+    // past the end, and the lanes it doesn't fill are left out
+    float paddedX[LANES];
+    float paddedY[LANES];
+    int result[LANES];
+    for(int k=0; k<LANES; k++) {
+        paddedX[k] = x0[std::min(k, count - 1)];
+        paddedY[k] = y0[std::min(k, count - 1)];
+    }
+    long skipped = escapeLanes<Formula>(level, paddedX, paddedY, count, result, juliaX, juliaY);
+    for(int k=0; k<count; k++)
+        levels[k] = result[k];
+    return skipped;
+}
+
+#else
+
+const int LANES = 1;
+
+#endif
+
+int escapeKernelLanes()
+{
+    return LANES;
+}
+
+// `count` pixels, the jth at (x0[j], y0[j*yStep]), so a row can pass LANES copies
+// of its y and a step of 0. Returns the iterations the interior checks skipped
+template<class Formula>
+static long escapeSpan(int level, const float* x0, const float* y0, int yStep, int count, int* levels,
+                       double juliaX, double juliaY)
+{
+    long skipped = 0;
+#if GLM_ARCH & (GLM_ARCH_AVX2_BIT | GLM_ARCH_SSE2_BIT)
+    for(int j=0; j < count; j += LANES)
+        skipped += escapeChunk<Formula>(level, x0 + j, y0 + j*yStep, std::min(LANES, count - j), levels + j, juliaX, juliaY);
+#else
+    for(int j=0; j<count; j++)
+        levels[j] = escapePixel<Formula>(level, x0[j], y0[j*yStep], juliaX, juliaY, skipped);
+#endif
+    return skipped;
+}
+
+// the kernel and description of every ESCAPE formula, in the same order. The
+// formula is only looked at here, once a call
+typedef long (*EscapeSpan)(int level, const float* x0, const float* y0, int yStep, int count, int* levels,
+                           double juliaX, double juliaY);
+
+struct FormulaRow {
+    EscapeSpan span;
+    EscapeFormula formula;
+};
+
+template<class Formula>
+static FormulaRow formulaRow()
+{
+    FormulaRow row = {escapeSpan<Formula>, {Formula::frame(), Formula::CONNECTED != 0, Formula::PERTURBED != 0}};
+    return row;
+}
+
+#define FORMULA_ROW(name, policy, scene) formulaRow<policy>(),
+
+static const FormulaRow formulaRows[ESCAPE::COUNT] = {
+    ESCAPE_FORMULAS(FORMULA_ROW, FORMULA_ROW)
+};
+
+const EscapeFormula& escapeFormula(int formula)
+{
+    return formulaRows[formula].formula;
+}
+
+void escapeRow(int formula, int level, const float* x0, float y0, int count, int* levels,
+               double juliaX, double juliaY)
+{
+    float row[LANES];
+    for(int k=0; k<LANES; k++)
+        row[k] = y0;
+    long skipped = formulaRows[formula].span(level, x0, row, 0, count, levels, juliaX, juliaY);
+    skippedIterations.fetch_add(skipped, std::memory_order_relaxed);
+}
+
+void escapePoints(int formula, int level, const float* x0, const float* y0, int count, int* levels,
+                  double juliaX, double juliaY)
+{
+    long skipped = formulaRows[formula].span(level, x0, y0, 1, count, levels, juliaX, juliaY);
+    skippedIterations.fetch_add(skipped, std::memory_order_relaxed);
+}
+
+void addSkippedIterations(long long iterations)
+{
+    skippedIterations.fetch_add(iterations, std::memory_order_relaxed);
+}
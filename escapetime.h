@@ -0,0 +1,101 @@
+// ==========================================================================
+// Escape-time kernel
+//
+// The inner loop of the Mandelbrot and Julia sets and their relatives:
+// iterate z = z^2 + c (or whichever formula it is) for every pixel until it
+// escapes the radius 2 circle or the level runs out. There's one kernel,
+// instantiated for every formula so none of them branch on it inside the loop.
+// Rows are done several pixels at a time with AVX2 (8 floats) or SSE2 (4
+// floats), whichever GLM_ARCH says the compiler is targeting. Pixels that are
+// inside the set are caught early, either by the closed form for the main
+// cardioid and period 2 bulb or by spotting that their orbit went round in a
+// cycle, instead of running until the level is used up.
+//
+// Modifications and additional functionality by Cameron Hardy (ID 10084560)
+// ==========================================================================
+
+#ifndef ESCAPETIME_H
+#define ESCAPETIME_H
+
+// Formulas
+// every formula there is, with its ESCAPE entry, its policy (in escapetime.cpp)
+// and the name of its scene. The ESCAPE entries, the kernels and the scenes are
+// all made from this list, so a new formula is its policy and a VARIANT line
+// here. The two SETs get the scenes before the Buddhabrots (which are on the
+// Mandelbrot set's lattice), and every VARIANT gets one after them, in order.
+//
+// MANDELBROT starts at z = 0 with c = the pixel, JULIA starts at z = the pixel
+// with c = juliaX + juliaY i, which the rest ignore. The others start like the
+// Mandelbrot set: BURNING_SHIP takes |x| + |y| i before squaring, TRICORN the
+// conjugate of z, and MULTIBROT is z^3 + c
+#define ESCAPE_FORMULAS(SET, VARIANT) \
+    SET(MANDELBROT,       MandelbrotFormula,  "Mandelbrot Set") \
+    SET(JULIA,            JuliaFormula,       "Julia Set") \
+    VARIANT(BURNING_SHIP, BurningShipFormula, "Burning Ship") \
+    VARIANT(TRICORN,      TricornFormula,     "Tricorn") \
+    VARIANT(MULTIBROT,    MultibrotFormula,   "Multibrot Set")
+
+#define ESCAPE_ENTRY(name, policy, scene) name,
+
+// which set a row belongs to
+struct ESCAPE{
+    enum {ESCAPE_FORMULAS(ESCAPE_ENTRY, ESCAPE_ENTRY) COUNT};
+};
+
+// the Julia set's c unless it's been moved
+const double JULIA_X = -0.8;
+const double JULIA_Y = 0.156;
+
+// where a formula's set sits on the plane at zoom 1. The window covers 3.5 x 3
+// of it from (left, bottom), give or take a pixel, and the vertices are that
+// moved into [-1.75, 1.75] x [-1.5, 1.5] and scaled down to [-1, 1] each way.
+// The colors go by where the vertices are, so the sets all get the same
+// colors wherever they are
+struct EscapeFrame {
+    float left;
+    float bottom;
+    
+    float shift() const { return -(left + 1.75f); }
+    float rise() const { return -(bottom + 1.5f); }
+};
+
+// what the images and generators need to know about a formula, which all
+// comes from its policy in escapetime.cpp
+struct EscapeFormula {
+    EscapeFrame frame;
+    bool connected;                         // whether subdivide can fill in its borders of one count
+    bool perturbed;                         // whether it's z^2 + c, the only formula perturbation knows
+};
+
+const EscapeFormula& escapeFormula(int formula);
+
+// iterates `count` pixels at (x0[j], y0) and writes how many of the `level`
+// iterations each one had left when it escaped to levels[j], or 0 if it never
+// did (or is inside the set)
+void escapeRow(int formula, int level, const float* x0, float y0, int count, int* levels,
+               double juliaX, double juliaY);
+
+// same thing for `count` pixels anywhere, the jth at (x0[j], y0[j])
+void escapePoints(int formula, int level, const float* x0, const float* y0, int count, int* levels,
+                  double juliaX, double juliaY);
+
+// whether c = x + y i is in the main cardioid or the period 2 bulb of the
+// Mandelbrot set, which the kernels catch without iterating
+bool mandelbrotCardioid(float x, float y);
+
+// how far around c = x + y i is certainly inside the Mandelbrot set, going by
+// the attracting cycle its orbit falls into, or 0 if it escapes or doesn't
+// settle within `level` iterations (which it won't close to the edge)
+double mandelbrotInteriorRadius(double x, double y, int level);
+
+// how many iterations the interior checks have saved, over every escapeRow call
+// from any thread since the program started
+long long escapeSkippedIterations();
+// counts iterations saved some other way, like filling in pixels without iterating them
+void addSkippedIterations(long long iterations);
+
+// which instruction set escapeRow was built for and how many pixels it does at once
+const char* escapeKernelName();
+int escapeKernelLanes();
+
+#endif
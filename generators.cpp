@@ -0,0 +1,1874 @@
+// ==========================================================================
+// Scene generators
+//
+// Everything that builds the geometry for the scenes. Nothing in here touches
+// OpenGL, so the generators can run on a worker thread, in the headless
+// renderer or in bench_generators without a window.
+//
+// Modifications and additional functionality by Cameron Hardy (ID 10084560)
+// ==========================================================================
+
+#include "generators.h"
+#include "buddhabrot.h"
+#include "escapetime.h"
+#include "tilepool.h"
+#include "tilestore.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+
+using namespace std;
+using namespace glm;
+
+// vec2 and vec3 are part of the glm math library.
+// Include in your own project by putting the glm directory in your project,
+// and including glm/glm.hpp as I have at the top of the file.
+// "using namespace glm;" will allow you to avoid writing everyting as glm::vec2
+
+// --------------------------------------------------------------------------
+// Cancellation
+
+// The window generates scenes on a worker thread. Every job gets an id, and once
+// the GL thread asks for something newer the long-running generators notice
+// here and bail out early. Called from anywhere else this is always false.
+atomic<int> requestedJob(0);                // newest job the GL thread asked for
+int runningJob = 0;                         // job the worker is on (only touched by the worker)
+
+bool generationCancelled()
+{
+    return runningJob != requestedJob.load(memory_order_relaxed);
+}
+
+// --------------------------------------------------------------------------
+// Incremental generation
+
+// The extendX functions take geometry that was generated for level `from` and
+// append whatever is needed to turn it into level `to`, so stepping up one level
+// only costs the new vertices. generateX(level) is just extendX from level 0.
+
+void extendSquares(int from, int to, vector<vec2>& points, vector<vec3>& colors) {
+    // set unique colors for squares and diamonds
+    vec3 squareColour(1.0, 0.5, 0.0);
+    vec3 diamondColor(0.0, 0.5, 1.0);
+    // set initial dimensions of the square
+    float size = 0.9;
+    
+    // catch up with the levels that are already drawn
+    for(int i=0; i<from; i++) {
+        size /= 2;
+        squareColour *= 0.8;
+        diamondColor *= 0.8;
+    }
+    
+    // each level draws a square containing a diamond
+    for(int i=from; i<to; i++) {
+        // draw a mediocre square
+        points.push_back(vec2(-size, -size));
+        points.push_back(vec2(-size,  size));
+        colors.push_back(squareColour);
+        colors.push_back(squareColour);
+        points.push_back(vec2(-size,  size));
+        points.push_back(vec2( size,  size));
+        colors.push_back(squareColour);
+        colors.push_back(squareColour);
+        points.push_back(vec2( size,  size));
+        points.push_back(vec2( size, -size));
+        colors.push_back(squareColour);
+        colors.push_back(squareColour);
+        points.push_back(vec2( size, -size));
+        points.push_back(vec2(-size, -size));
+        colors.push_back(squareColour);
+        colors.push_back(squareColour);
+    
+        // draw a mediocre diamond
+        points.push_back(vec2( 0.0, -size));
+        points.push_back(vec2(-size,  0.0));
+        colors.push_back(diamondColor);
+        colors.push_back(diamondColor);
+        points.push_back(vec2(-size,  0.0));
+        points.push_back(vec2( 0.0,  size));
+        colors.push_back(diamondColor);
+        colors.push_back(diamondColor);
+        points.push_back(vec2( 0.0,  size));
+        points.push_back(vec2( size,  0.0));
+        colors.push_back(diamondColor);
+        colors.push_back(diamondColor);
+        points.push_back(vec2( size,  0.0));
+        points.push_back(vec2( 0.0, -size));
+        colors.push_back(diamondColor);
+        colors.push_back(diamondColor);
+        
+        size /= 2;
+        // fade the color towards black a little bit each iteration
+        squareColour *= 0.8;
+        diamondColor *= 0.8;
+    }
+}
+
+void generateSquares(int level, vector<vec2>& points, vector<vec3>& colors) {
+    points.clear();
+    colors.clear();
+    extendSquares(0, level, points, colors);
+}
+
+void generateSpiral(int level, vector<vec2>& points, vector<vec3>& colors) {
+    points.clear();
+    colors.clear();
+    
+    // define start and end colors for the spiral to fade between
+    vec3 startColor(0.0, 1.0, 0.5);
+    vec3 endColor(1.0, 0.0, 0.5);
+    
+    float t = 0;
+    float bound = level*2*3.141592653589793238462643383;
+    // an interval of 0.01 between points produces a nice smooth spiral
+    float interval = 0.01;
+    float a = (1/bound);
+    
+    // generate the spiral with a simple parametric equation
+    // blend between the start and end colors
+    for(t=0; t<bound; t+=interval) {
+        points.push_back(vec2(a*t*cos(t), a*t*sin(t)));
+        colors.push_back(startColor*(1-(a*t)) + endColor*(a*t));
+    }
+}
+
+void drawTriangle(int level, vec2 pointA, vec2 pointB, vec2 pointC, vec3 color, vector<vec2>& points, vector<vec3>& colors) {
+    if(level<=0) {
+        // draw triangle with vertexes A, B, and C
+        points.push_back(pointA);
+        points.push_back(pointB);
+        points.push_back(pointC);
+        colors.push_back(color);
+        colors.push_back(color);
+        colors.push_back(color);
+    }
+    else {
+        // calculate the midpoints of the current triangle, and then recursively draw 3 smaller triangles using two of the midpoints and one of the original corners
+        // it also recursively increases one RGB value while decreasing the other two values - produces a cool swirl effect
+        drawTriangle(level-1, pointA, vec2((pointA.x+pointB.x)/2, (pointA.y+pointB.y)/2), vec2((pointA.x+pointC.x)/2, (pointA.y+pointC.y)/2), color*vec3(1.2, 0.8, 0.8), points, colors);
+        drawTriangle(level-1, pointB, vec2((pointB.x+pointA.x)/2, (pointB.y+pointA.y)/2), vec2((pointB.x+pointC.x)/2, (pointB.y+pointC.y)/2), color*vec3(0.8, 1.2, 0.8), points, colors);
+        drawTriangle(level-1, pointC, vec2((pointC.x+pointA.x)/2, (pointC.y+pointA.y)/2), vec2((pointC.x+pointB.x)/2, (pointC.y+pointB.y)/2), color*vec3(0.8, 0.8, 1.2), points, colors);
+    }
+}
+
+void generateSierpinski(int level, vector<vec2>& points, vector<vec3>& colors) {
+    points.clear();
+    colors.clear();
+
+    // set the intial color value and then get started on the recursion (yee haw)
+    vec3 color(0.5, 0.5, 0.5);
+    drawTriangle(level, vec2(-1.0, -0.933), vec2(0.0, 0.933), vec2(1.0, -0.933), color, points, colors);
+}
+
+void generateSnowFractal(int level){
+    // TODO: make da snow fractal (if you feel sassy enough)
+    // this fractal reminded me of winter and that put me in a foul mood
+    // instead of snow fractals, I made a dragon curve, which you'll have to admit is way more badass
+}
+
+void extendFern(int from, int to, vector<vec2>& points, vector<vec3>& colors) {
+    // set initial color value
+    vec3 color(0.5, 0.5, 0.5);
+    
+    float x = 0;
+    float y = 0;
+    float xPrev;
+    float yPrev;
+    
+    // the chaos game doesn't care where it starts as long as it's on the fern,
+    // so just keep going from the last point we drew (undoing the scaling below)
+    if(!points.empty()) {
+        x = points.back().x*3;
+        y = (points.back().y+1.0)*5.3;
+        color = colors.back();
+    }
+    
+    // since this fractal is probability-based, it needs TONS of iterations
+    int count = (to-from)*50000;
+    for (int i = 0; i<count; i++) {
+        // check in once per level's worth of points
+        if(i%50000 == 0 && generationCancelled())
+            return;
+        
+        xPrev = x;
+        yPrev = y;
+        // choose a random number between 0 and 99
+        // depending on the result, the next point to be drawn gets mapped to a new part of the fern based on specific probabilities
+        int seed = rand()%100;
+        // maps to the first stem
+        if(seed == 0) {
+            x = 0;
+            y = 0.16*yPrev;
+            // make the stem white
+            color = vec3(1.0, 1.0, 1.0);
+        }
+        // maps to the next level
+        else if(0<seed && seed<=85) {
+            x = 0.85*xPrev + 0.04*yPrev;
+            y = -0.04*xPrev + 0.85*yPrev + 1.6;
+            // make the fern fade out near the tip
+            color *= vec3(0.95, 0.95, 0.95);
+        }
+        // maps to the left side
+        else if(85<seed && seed<=92) {
+            x = 0.2*xPrev - 0.26*yPrev;
+            y = 0.23*xPrev + 0.22*yPrev + 1.6;
+            // make the left side red
+            color = vec3(1.0, 0.2, 0.2);
+        }
+        //maps to the right side
+        else if(92<seed && seed<=99) {
+            x = -0.15*xPrev + 0.28*yPrev;
+            y = 0.26*xPrev + 0.24*yPrev + 0.44;
+            // make the right side blue
+            color = vec3(0.2, 0.2, 1.0);
+        }
+        
+        // apply some scaling and translating to make sure it fits in the render window
+        points.push_back(vec2((x/3), (y/5.3)-1.0));
+        colors.push_back(color);
+    }
+}
+
+void generateFern(int level, vector<vec2>& points, vector<vec3>& colors) {
+    points.clear();
+    colors.clear();
+    extendFern(0, level, points, colors);
+}
+
+vec2 plotLeft(vec2 pointA, vec2 pointB, int mode) {
+    // calculate midpoint of A and B
+    vec2 midpoint((pointA.x+pointB.x)/2, (pointA.y+pointB.y)/2);
+    // calculate the change in each dimension
+    vec2 delta = midpoint - pointA;
+    
+    // depending on which mode we're in, calcluate the extrusion on the left
+    if(mode%4 == 0)
+        return vec2(midpoint.x, midpoint.y+delta.x);
+    if(mode%4 == 1)
+        return vec2(pointA.x, pointB.y);
+    if(mode%4 == 2)
+        return vec2(midpoint.x-delta.y, midpoint.y);
+    if(mode%4 == 3)
+        return vec2(pointB.x, pointA.y);
+    
+    // this is here for bug catching
+    // under normal circumstances this should never be returned
+    return vec2(2.0, 2.0);
+}
+
+vec2 plotRight(vec2 pointA, vec2 pointB, int mode) {
+    // calculate midpoint of A and B
+    vec2 midpoint((pointA.x+pointB.x)/2, (pointA.y+pointB.y)/2);
+    // calculate the change in each dimension
+    vec2 delta = midpoint - pointA;
+    
+    // depending on which mode we're in, calcluate the extrusion on the right
+    if(mode%4 == 0)
+        return vec2(midpoint.x, midpoint.y-delta.x);
+    if(mode%4 == 1)
+        return vec2(pointB.x, pointA.y);
+    if(mode%4 == 2)
+        return vec2(midpoint.x+delta.y, midpoint.y);
+    if(mode%4 == 3)
+        return vec2(pointA.x, pointB.y);
+    
+    // this is here for bug catching
+    // under normal circumstances, this should never be returned
+    return vec2(2.0, 2.0);
+}
+
+void extendDragon(int from, int to, vector<vec2>& points, vector<vec3>& colors) {
+    vector<vec2> array;
+    
+    // initial coordinates and colors
+    if(points.empty()) {
+        array.push_back(vec2(-0.7, 0.2));
+        array.push_back(vec2(0.5, 0.2));
+        from = 1;
+    }
+    else {
+        array = points;
+    }
+    vec3 startColor(0.0, 0.6, 0.9);
+    vec3 endColor(1.0, 0.4, 0.1);
+    
+    // there are 4 "modes" to aid with folding calculations
+    // the mode tells the function which way the line is propagating, so it know which way to extrude
+    // Mode 0 = west/east
+    // Mode 1 = northeast/southwest
+    // Mode 2 = north/south
+    // Mode 3 = northwest/southeast
+    // every fold inserts one point per segment (2 mode shifts each) and then shifts once more,
+    // so replay that to find out where the folds we already did left off
+    bool right = true;
+    int mode = 0;
+    for(int i=1, segments=1; i<from; i++, segments *= 2) {
+        mode = (mode + 2*segments + 1) % 4;
+        if(segments%2 == 1)
+            right = !right;
+    }
+    
+    vector<vec2> folded;
+    while(from < to) {
+        if(generationCancelled())
+            return;
+        
+        // walk through adjacent pairs of points and put a new point between them
+        // building a fresh array keeps each fold linear instead of inserting into the middle of a vector
+        folded.clear();
+        folded.reserve(2*array.size() - 1);
+        for(size_t index=0; index+1 < array.size(); index++) {
+            folded.push_back(array[index]);
+            // alternate between turning left and right
+            if(right) {
+                folded.push_back(plotRight(array[index], array[index+1], mode));
+                right = false;
+            }
+            else if(!right) {
+                folded.push_back(plotLeft(array[index], array[index+1], mode));
+                right = true;
+            }
+            // a 90 turn = a mode shift of 2
+            mode += 2;
+        }
+        folded.push_back(array.back());
+        array.swap(folded);
+        
+        // shift the mode to prepare for the next level
+        mode++;
+        from++;
+    }
+    
+    // draw all points and blend between two colors
+    // every point moves along the gradient when the curve grows, so all of them are rewritten
+    points.swap(array);
+    colors.clear();
+    float size = points.size();
+    for(size_t i=0; i<points.size(); i++) {
+        colors.push_back(startColor*(1-(i/size)) + endColor*(i/size));
+    }
+}
+
+void generateDragon(int level, vector<vec2>& points, vector<vec3>& colors) {
+    points.clear();
+    colors.clear();
+    extendDragon(1, level, points, colors);
+}
+
+vec3 hsv_to_rgb(float h, float s, float v) {
+    if(v>1.0)
+        v = 1.0;
+    float hp = h/60.0;
+    float c = v*s;
+    float x = c*(1-abs((fmod(hp, 2)-1)));
+    vec3 rgb(0.0, 0.0, 0.0);
+    
+    if(0<=hp && hp<1)
+        rgb = vec3(c, x, 0);
+    if(1<=hp && hp<2)
+        rgb = vec3(x, c, 0);
+    if(2<=hp && hp<3)
+        rgb = vec3(0, c, x);
+    if(3<=hp && hp<4)
+        rgb = vec3(0, x, c);
+    if(4<=hp && hp<5)
+        rgb = vec3(x, 0, c);
+    if(5<=hp && hp<6)
+        rgb = vec3(c, 0, x);
+    
+    float m = v - c;
+    rgb += vec3(m, m, m);
+    
+    return rgb;
+}
+
+vec3 mapColor(int i, float r, float c) {
+    int di = i;
+    float zn;
+    float hue;
+    
+    zn = sqrt(r + c);
+    hue = di + 1.0 - log(log(abs(zn))) / log(2.0);
+    hue = 0.95 + 20.0 * hue;
+    // wrapped into (0, 360] (or [0, 360) coming up from below), which used to be
+    // a loop taking 360 off at a time. Each of those was exact, so fmod gives
+    // exactly the same answer without taking longer the higher the level
+    float wrapped = fmod(hue, 360.0f);
+    if(wrapped < 0.0f)
+        wrapped += 360.0f;
+    else if(wrapped == 0.0f && hue > 0.0f)
+        wrapped = 360.0f;
+    hue = wrapped;
+    
+    return hsv_to_rgb(hue, 0.8, 1.0);
+}
+
+// Palette
+// The images color every pixel the same way as mapColor, but a whole row at a
+// time and with the palette looked up in a table instead of going through
+// hsv_to_rgb. The hue only depends on the iterations left and on
+// log2(log2(r + c)) (mapColor's log(log(sqrt(r + c)))/log(2) with the
+// constants pulled out), so that gets a fast log2 that the compiler can do
+// several pixels at once, and the iterations are wrapped by 18 (20 degrees
+// each) before they go anywhere near a float. The table has PALETTE_SIZE hues
+// around the circle, which is within a shade of mapColor, plus gray for the
+// pixels where mapColor's logs come out NaN and black for the ones that never
+// escaped.
+const int PALETTE_SIZE = 4096;
+const int PALETTE_NAN = PALETTE_SIZE;
+const int PALETTE_BLACK = PALETTE_SIZE + 1;
+
+struct Palette {
+    unsigned char rgba[PALETTE_SIZE + 2][4];
+    
+    Palette() {
+        for(int k=0; k<PALETTE_SIZE + 2; k++) {
+            vec3 color;
+            if(k == PALETTE_BLACK)
+                color = vec3(0.0, 0.0, 0.0);
+            else if(k == PALETTE_NAN)
+                color = hsv_to_rgb(NAN, 0.8, 1.0);
+            else
+                color = hsv_to_rgb(k*360.0f/PALETTE_SIZE, 0.8, 1.0);
+            // rounded the same way the rasterizer and GL turn colors into bytes
+            rgba[k][0] = (unsigned char)(color.r*255.0f + 0.5f);
+            rgba[k][1] = (unsigned char)(color.g*255.0f + 0.5f);
+            rgba[k][2] = (unsigned char)(color.b*255.0f + 0.5f);
+            rgba[k][3] = 255;
+        }
+    }
+};
+
+static const Palette palette;
+
+// log2 to about 1e-7, from the exponent and a short series for the mantissa
+// (scaled into [sqrt(1/2), sqrt(2)) so the series converges quickly). It's all
+// bit twiddling with no float compares, and finite for anything it's given
+static inline float fastLog2(float v) {
+    int bits;
+    memcpy(&bits, &v, sizeof(bits));
+    int exponent = ((bits >> 23) & 0xff) - 127;
+    int mantissa = bits & 0x007fffff;
+    int big = mantissa > 0x3504f3;          // above sqrt(2), so halve it
+    bits = mantissa | (0x3f800000 - (big << 23));
+    float m;
+    memcpy(&m, &bits, sizeof(m));
+    float t = (m - 1.0f)/(m + 1.0f);
+    float t2 = t*t;
+    return (float)(exponent + big) + t*(2.88539008f + t2*(0.961796694f + t2*(0.577078016f + t2*0.412198583f)));
+}
+
+// the palette entry for one pixel, as mapColor would color it. The NaN and
+// black picks are masks rather than branches so the compiler can't sink the
+// hue into one side of them, which would stop it doing several pixels at once
+static inline int paletteEntry(int level, float column, float y0, float shift) {
+    float x0 = (column + shift)/1.75;
+    float r = 360.0*x0 + 365.0;
+    float sum = r + y0;
+    
+    // log2(log(sqrt(sum))) = log2(log2(sum)) + log2(log(2)/2)
+    float smooth = fastLog2(fastLog2(sum)) - 1.52876637f;
+    float hue = 0.95f + 20.0f*((float)(level % 18) + 1.0f - smooth);
+    // smooth is finite, so this stays well inside an int. + a multiple of the
+    // palette size so truncating rounds even below 0
+    int entry = (int)(hue*(PALETTE_SIZE/360.0f) + 0.5f + 256.0f*PALETTE_SIZE) & (PALETTE_SIZE - 1);
+    
+    int bits;
+    memcpy(&bits, &sum, sizeof(bits));
+    int nan = -(bits <= 0x3f800000);        // sum <= 1 (or negative), where mapColor's logs are NaN
+    int black = -(level == 0);
+    entry = (entry & ~nan) | (PALETTE_NAN & nan);
+    return (entry & ~black) | (PALETTE_BLACK & black);
+}
+
+// palette entries for `count` pixels of a row. Blocks of 8 have a fixed trip
+// count, which is what -O2 needs before it'll vectorize a loop
+static void paletteRow(const int* __restrict levels, const float* __restrict column, float row, float shift, float rise,
+                       int count, int* __restrict entries) {
+    float y0 = (row + rise)/1.5;
+    int j = 0;
+    for(; j + 8 <= count; j += 8)
+        for(int k=0; k<8; k++)
+            entries[j + k] = paletteEntry(levels[j + k], column[j + k], y0, shift);
+    for(; j<count; j++)
+        entries[j] = paletteEntry(levels[j], column[j], y0, shift);
+}
+
+// Threads
+int generatorThreads = 0;
+
+// The image is cut into tiles that the tile pool hands out to every core. Each
+// tile works out how many iterations every one of its pixels had left, either
+// row by row with escapeRow (which does several pixels at once) or by
+// subdividing it, then writes its results straight into place in the
+// preallocated outputs: a vertex per pixel into points/colors, or an RGBA8
+// texel per pixel into rgba. The pixel coordinates and colors are worked out
+// the same as always.
+//
+// Each point sits right on the corner of a pixel and GL draws it into the pixel
+// below and to the left, so the image takes texel (j, i) from point (j+1, i+1)
+// to come out exactly where the points did
+//
+// A coarse pass of an image works the same way on the lattice of every
+// stride-th pixel, so its tiles cover stride times as many pixels each way
+const int ESCAPE_TILE_WIDTH = 64;
+const int ESCAPE_TILE_HEIGHT = 8;
+const int SUBDIVIDE_TILE_HEIGHT = 64;      // subdividing needs room to find big uniform areas
+
+// Mariani-Silver subdivision
+// A tile starts out as one rectangle: iterate its border, and if that's uniform
+// fill in the inside without iterating it, otherwise split it in two along the
+// longer side and try again with each half. Rectangles too thin to be worth
+// splitting just get every pixel iterated. That's only right where nothing
+// else can be inside a border of one count, so it's only done for formulas
+// that say their set is CONNECTED, which so far is just the Mandelbrot set:
+//  - The points that last at least n iterations make a disc (with the whole
+//    set in it), so the ones that escape after exactly n are the ring between
+//    two of them. Anything inside a border that's all in that ring is in it
+//    too, unless the rectangle has the whole set in it, which it can't without
+//    the origin.
+//  - The set itself has no holes either, but the outside reaches into it in
+//    channels narrower than a pixel (between the bulbs), which can slip between
+//    the pixels of a border that never escaped. So those borders also get the
+//    interior distance estimate (see mandelbrotInteriorRadius), and the inside
+//    is only filled in if the discs around the border pixels that are certainly
+//    in the set cover the whole way round. Past DEEP_ZOOM the pixels are too
+//    close together for that, and the inside always gets iterated.
+bool escapeSubdivide = false;
+
+const int SUBDIVIDE_MIN = 12;               // split rectangles until they're this thin
+const int UNKNOWN = -1;                     // pixel nobody has asked for yet
+const int QUEUED = -2;                      // pixel waiting for the next batch
+const int REUSED = -3;                      // pixel an earlier call already iterated
+const int FILLED = -4;                      // pixel subdivide filled in, which the tile store doesn't get
+
+struct EscapeTile {
+    int formula;
+    int level;
+    double juliaX;
+    double juliaY;
+    int width;                              // of the tile, its pixels go row by row in levels
+    const float* column;                    // x of every column of the tile
+    const float* row;                       // and y of every row
+    int* levels;
+    long long skipped;                      // iterations saved by filling in rectangles
+    const ReferenceOrbit* orbit;            // past DEEP_ZOOM the pixels are perturbed from this
+    const double* deltaColumn;              // instead, by how far every column
+    const double* deltaRow;                 // and row is from the reference point
+    double* radius;                         // mandelbrotInteriorRadius of each pixel, -1 until it's needed
+    vector<int> filled;                     // rectangles filled in without iterating, as x0, y0, x1, y1
+    
+    // pixels to be iterated in the next batch, with their coordinates
+    vector<int> batch;
+    vector<float> batchX;
+    vector<float> batchY;
+    vector<double> batchDX;
+    vector<double> batchDY;
+    vector<int> batchLevels;
+};
+
+// what every thread keeps from one tile to the next, so the tiles don't allocate
+struct TileScratch {
+    vector<int> levels;
+    vector<double> radius;
+    EscapeTile tile;
+};
+
+static void queuePixel(EscapeTile& tile, int j, int i)
+{
+    int& pixel = tile.levels[i*tile.width + j];
+    if(pixel != UNKNOWN)
+        return;
+    pixel = QUEUED;
+    tile.batch.push_back(i*tile.width + j);
+    if(tile.orbit) {
+        tile.batchDX.push_back(tile.deltaColumn[j]);
+        tile.batchDY.push_back(tile.deltaRow[i]);
+    }
+    else {
+        tile.batchX.push_back(tile.column[j]);
+        tile.batchY.push_back(tile.row[i]);
+    }
+}
+
+// iterates everything that was queued, as many pixels at a time as escapePoints can
+static void iterateBatch(EscapeTile& tile)
+{
+    int count = (int)tile.batch.size();
+    tile.batchLevels.resize(count);
+    if(tile.orbit)
+        perturbPoints(*tile.orbit, tile.batchDX.data(), tile.batchDY.data(), count, tile.batchLevels.data());
+    else
+        escapePoints(tile.formula, tile.level, tile.batchX.data(), tile.batchY.data(), count, tile.batchLevels.data(),
+                     tile.juliaX, tile.juliaY);
+    for(int k=0; k<count; k++)
+        tile.levels[tile.batch[k]] = tile.batchLevels[k];
+    tile.batch.clear();
+    tile.batchX.clear();
+    tile.batchY.clear();
+    tile.batchDX.clear();
+    tile.batchDY.clear();
+}
+
+static double interiorRadius(EscapeTile& tile, int j, int i)
+{
+    double& radius = tile.radius[i*tile.width + j];
+    if(radius < 0.0)
+        radius = mandelbrotInteriorRadius(tile.column[j], tile.row[i], tile.level);
+    return radius;
+}
+
+// whether discs that are certainly inside the set cover the whole border of
+// [x0, x1] x [y0, y1]. Going round it, a pixel only needs its disc worked out
+// once the next pixel isn't covered yet, and the discs are usually many pixels
+// across, so most border pixels never need one
+static bool interiorBorder(EscapeTile& tile, int x0, int y0, int x1, int y1)
+{
+    // the estimate only knows z^2 + c
+    if(tile.orbit || tile.formula != ESCAPE::MANDELBROT)
+        return false;
+    // pixels in the main cardioid or the period 2 bulb cost nothing to iterate,
+    // so there's nothing to save in a rectangle that touches them (and if it
+    // leaves them too it's gone through a pinch, so it'd be split anyway)
+    for(int j=x0; j<=x1; j++) {
+        if(mandelbrotCardioid(tile.column[j], tile.row[y0]) || mandelbrotCardioid(tile.column[j], tile.row[y1]))
+            return false;
+    }
+    for(int i=y0+1; i<y1; i++) {
+        if(mandelbrotCardioid(tile.column[x0], tile.row[i]) || mandelbrotCardioid(tile.column[x1], tile.row[i]))
+            return false;
+    }
+    
+    // once round, starting and ending at the bottom left corner, with reach
+    // how far round the border is covered so far
+    int j = x0;
+    int i = y0;
+    double along = 0.0;
+    double reach = interiorRadius(tile, j, i);
+    bool counted = true;                    // whether the pixel we're on has its disc in reach
+    int steps = 2*(x1 - x0) + 2*(y1 - y0);
+    for(int k=0; k<steps; k++) {
+        int nextJ = j + (i == y0 && j < x1) - (i == y1 && j > x0);
+        int nextI = i + (j == x1 && i < y1) - (j == x0 && i > y0);
+        double gap = hypot((double)tile.column[nextJ] - tile.column[j], (double)tile.row[nextI] - tile.row[i]);
+        double next = along + gap;
+        if(next >= reach && !counted)
+            reach = std::max(reach, along + interiorRadius(tile, j, i));
+        
+        j = nextJ;
+        i = nextI;
+        along = next;
+        counted = false;
+        if(along >= reach) {
+            // out of reach, so this one's disc has to close the gap back to it
+            double radius = interiorRadius(tile, j, i);
+            if(along - radius >= reach || radius < gap)
+                return false;
+            reach = along + radius;
+            counted = true;
+        }
+    }
+    return true;
+}
+
+// fills in the rectangle [x0, x1] x [y0, y1] of a tile (inclusive), though some
+// of it may still be queued when it returns, for the caller to iterate
+static void subdivide(EscapeTile& tile, int x0, int y0, int x1, int y1)
+{
+    // a side at a time, so the pixels iterated side by side are neighbours
+    // and tend to escape together
+    for(int j=x0; j<=x1; j++)
+        queuePixel(tile, j, y0);
+    for(int j=x0; j<=x1; j++)
+        queuePixel(tile, j, y1);
+    for(int i=y0+1; i<y1; i++)
+        queuePixel(tile, x0, i);
+    for(int i=y0+1; i<y1; i++)
+        queuePixel(tile, x1, i);
+    iterateBatch(tile);
+    if(x1 - x0 < 2 || y1 - y0 < 2)
+        return;                             // all border, nothing inside
+    
+    int* levels = tile.levels;
+    int w = tile.width;
+    int border = levels[y0*w + x0];
+    bool uniform = true;
+    for(int j=x0; j<=x1 && uniform; j++)
+        uniform = levels[y0*w + j] == border && levels[y1*w + j] == border;
+    for(int i=y0+1; i<y1 && uniform; i++)
+        uniform = levels[i*w + x0] == border && levels[i*w + x1] == border;
+    if(uniform && border == 0)
+        uniform = interiorBorder(tile, x0, y0, x1, y1);
+    else if(uniform && tile.column[x0] <= 0.0f && tile.column[x1] >= 0.0f && tile.row[y0] <= 0.0f && tile.row[y1] >= 0.0f)
+        uniform = false;
+    
+    if(uniform) {
+        for(int i=y0+1; i<y1; i++) {
+            for(int j=x0+1; j<x1; j++)
+                levels[i*w + j] = border;
+        }
+        tile.filled.push_back(x0);
+        tile.filled.push_back(y0);
+        tile.filled.push_back(x1);
+        tile.filled.push_back(y1);
+        // every one of those would have taken level - border iterations
+        tile.skipped += (long long)(x1 - x0 - 1)*(y1 - y0 - 1)*(tile.level - border);
+        return;
+    }
+    
+    // nothing else looks inside, so it waits in the batch for whatever's
+    // iterated next rather than being a (short) batch of its own
+    if(x1 - x0 <= SUBDIVIDE_MIN || y1 - y0 <= SUBDIVIDE_MIN) {
+        for(int i=y0+1; i<y1; i++) {
+            for(int j=x0+1; j<x1; j++)
+                queuePixel(tile, j, i);
+        }
+        return;
+    }
+    
+    // the halves share the line they're split along, which only gets iterated once
+    if(x1 - x0 >= y1 - y0) {
+        int middle = (x0 + x1)/2;
+        subdivide(tile, x0, y0, middle, y1);
+        subdivide(tile, middle, y0, x1, y1);
+    }
+    else {
+        int middle = (y0 + y1)/2;
+        subdivide(tile, x0, y0, x1, middle);
+        subdivide(tile, x0, middle, x1, y1);
+    }
+}
+
+// Deep zoom
+// The reference point goes on the lattice near the middle of the view, and
+// doesn't move when the view is panned, so its orbit is worked out once per
+// zoom (and level) and kept for every pass and pan after that. If the middle
+// escapes early a few other points are tried and the longest orbit is kept,
+// since pixels still going after the reference escaped have to be rebased.
+struct DeepReference {
+    ReferenceOrbit orbit;
+    int width;                              // of the lattice it was picked for
+    int height;
+    EscapeView view;
+    int j;                                  // and the lattice point it's on
+    int i;
+    bool finished;
+    
+    DeepReference() : width(0), height(0), j(0), i(0), finished(false) {}
+};
+
+// only touched by whoever's making images, one at a time
+static DeepReference deepReference;
+
+// the reference orbit for a deep view, or null if it was cancelled
+static const DeepReference* findReference(int formula, int level, int width, int height, const EscapeView& view) {
+    DeepReference& reference = deepReference;
+    if(reference.finished && reference.orbit.formula == formula && reference.orbit.level == level &&
+       reference.width == width && reference.height == height && sameLattice(reference.view, view))
+        return &reference;
+    
+    reference.finished = false;
+    reference.width = width;
+    reference.height = height;
+    reference.view = view;
+    
+    DeepFixed unitX = deepFromDouble(3.5/(float)width/view.zoom);
+    DeepFixed unitY = deepFromDouble(3.0/(float)height/view.zoom);
+    const EscapeFrame& frame = escapeFormula(formula).frame;
+    DeepFixed originX = deepAdd(view.x, deepFromDouble(frame.left));
+    DeepFixed originY = deepAdd(view.y, deepFromDouble(frame.bottom));
+    
+    // the middle, then the middles of the quarters around it
+    const int candidates[9][2] = {{2, 2}, {1, 1}, {3, 1}, {1, 3}, {3, 3}, {2, 1}, {1, 2}, {3, 2}, {2, 3}};
+    ReferenceOrbit orbit;
+    for(int c=0; c<9; c++) {
+        int j = width*candidates[c][0]/4;
+        int i = height*candidates[c][1]/4;
+        DeepFixed x = deepAdd(originX, deepMul(unitX, deepFromDouble(j)));
+        DeepFixed y = deepAdd(originY, deepMul(unitY, deepFromDouble(i)));
+        if(!referenceOrbit(orbit, formula, level, x, y, view.juliaX, view.juliaY, generationCancelled))
+            return 0;
+        if(c == 0 || orbit.zx.size() > reference.orbit.zx.size()) {
+            swap(reference.orbit, orbit);
+            reference.j = j;
+            reference.i = i;
+        }
+        if((int)reference.orbit.zx.size() > level)
+            break;                          // never escapes, can't do better than that
+    }
+    reference.finished = true;
+    return &reference;
+}
+
+static void escapeTiles(int formula, int level, int width, int height, const EscapeView& view, int stride, int* known,
+                        vec2* points, vec3* colors, unsigned char* rgba) {
+    const EscapeFrame& frame = escapeFormula(formula).frame;
+    float shift = frame.shift();
+    float rise = frame.rise();
+    int corner = rgba ? 1 : 0;
+    int across = (width + stride - 1)/stride;
+    int down = (height + stride - 1)/stride;
+    vector<float> column(across);
+    for(int j=0; j<across; j++)
+        column[j] = (3.5/(float)width/view.zoom)*(j*stride+corner+view.panX)+frame.left+deepToDouble(view.x);
+    vector<float> row(down);
+    for(int i=0; i<down; i++)
+        row[i] = (3.0/(float)height/view.zoom)*(i*stride+corner+view.panY)+frame.bottom+deepToDouble(view.y);
+    
+    // too deep for floats, so every pixel goes by how far it is from the reference
+    // (the coordinates above are still close enough to color them by). It's
+    // only worked out once a tile has something to iterate, so an image that
+    // all comes out of the tile store doesn't need one
+    bool deep = rgba && view.zoom >= DEEP_ZOOM && escapeFormula(formula).perturbed;
+    const ReferenceOrbit* orbit = 0;
+    vector<double> deltaColumn;
+    vector<double> deltaRow;
+    bool referenced = false;
+    mutex referenceLock;
+    auto findOrbit = [&]() {
+        lock_guard<mutex> guard(referenceLock);
+        if(referenced)
+            return orbit != 0;
+        referenced = true;
+        const DeepReference* reference = findReference(formula, level, width, height, view);
+        if(!reference)
+            return false;
+        deltaColumn.resize(across);
+        for(int j=0; j<across; j++)
+            deltaColumn[j] = (3.5/(float)width/view.zoom)*(j*stride+corner+view.panX - reference->j);
+        deltaRow.resize(down);
+        for(int i=0; i<down; i++)
+            deltaRow[i] = (3.0/(float)height/view.zoom)*(i*stride+corner+view.panY - reference->i);
+        orbit = &reference->orbit;
+        return true;
+    };
+    
+    // texel (j, i) is point (j*stride + corner + panX, i*stride + corner + panY) of this lattice
+    bool store = known && tileStoreOpen();
+    TileLattice lattice = {formula, level, view.juliaX, view.juliaY, 3.5/(float)width/view.zoom, 3.0/(float)height/view.zoom,
+                           view.x, view.y};
+    
+    // points a thread's EscapeTile at the tile with its top left pixel at (first, top)
+    auto startTile = [&](TileScratch& scratch, int first, int top, int count) -> EscapeTile& {
+        EscapeTile& tile = scratch.tile;
+        tile.formula = formula;
+        tile.level = level;
+        tile.juliaX = view.juliaX;
+        tile.juliaY = view.juliaY;
+        tile.width = count;
+        tile.column = &column[first];
+        tile.row = &row[top];
+        tile.levels = scratch.levels.data();
+        tile.skipped = 0;
+        tile.orbit = orbit;
+        tile.deltaColumn = orbit ? &deltaColumn[first] : 0;
+        tile.deltaRow = orbit ? &deltaRow[top] : 0;
+        tile.radius = scratch.radius.data();
+        return tile;
+    };
+    
+    // only a connected set can be subdivided without changing the image
+    bool subdividing = escapeSubdivide && escapeFormula(formula).connected;
+    int tileHeight = subdividing ? SUBDIVIDE_TILE_HEIGHT : ESCAPE_TILE_HEIGHT;
+    int columns = (across + ESCAPE_TILE_WIDTH - 1)/ESCAPE_TILE_WIDTH;
+    int rows = (down + tileHeight - 1)/tileHeight;
+    
+    vector<TileScratch> scratch(tileThreads(generatorThreads));
+    runThreadTiles(columns*rows, generatorThreads, [&](int tile, int thread) {
+        if(generationCancelled())
+            return;
+        
+        int first = (tile%columns)*ESCAPE_TILE_WIDTH;
+        int count = std::min(ESCAPE_TILE_WIDTH, across - first);
+        int top = (tile/columns)*tileHeight;
+        int bottom = std::min(top + tileHeight, down);
+        vector<int>& levels = scratch[thread].levels;
+        levels.assign((size_t)count*(bottom - top), UNKNOWN);
+        scratch[thread].tile.filled.clear();
+        
+        // texels some earlier call already iterated are left alone
+        int reused = 0;
+        if(known) {
+            for(int i=top; i<bottom; i++) {
+                for(int j=0; j<count; j++) {
+                    if(known[(size_t)i*stride*width + (first + j)*stride] != UNKNOWN) {
+                        levels[(i - top)*count + j] = REUSED;
+                        reused++;
+                    }
+                }
+            }
+        }
+        
+        // and the ones the tile store has only need coloring
+        int stored = 0;
+        if(store) {
+            int found[ESCAPE_TILE_WIDTH];
+            for(int i=top; i<bottom; i++) {
+                readTileStore(lattice, first*stride + corner + view.panX, i*stride + corner + view.panY, stride, count, found);
+                for(int j=0; j<count; j++) {
+                    int& pixel = levels[(i - top)*count + j];
+                    if(pixel == UNKNOWN && found[j] >= 0) {
+                        pixel = found[j];
+                        stored++;
+                    }
+                }
+            }
+        }
+        
+        int total = count*(bottom - top);
+        int unknown = total - reused - stored;
+        if(reused == total)
+            return;
+        if(unknown && deep && !findOrbit())
+            return;
+        if(!unknown) {
+            // the store had every one of them, so there's nothing to iterate
+        }
+        else if(reused || stored || (orbit && !subdividing)) {
+            // only the ones that are left, as many at a time as escapePoints can
+            EscapeTile& samples = startTile(scratch[thread], first, top, count);
+            for(int i=top; i<bottom; i++) {
+                for(int j=0; j<count; j++)
+                    queuePixel(samples, j, i - top);
+            }
+            iterateBatch(samples);
+        }
+        else if(subdividing) {
+            scratch[thread].radius.assign(levels.size(), -1.0);
+            EscapeTile& rectangle = startTile(scratch[thread], first, top, count);
+            subdivide(rectangle, 0, 0, count - 1, bottom - top - 1);
+            iterateBatch(rectangle);
+            addSkippedIterations(rectangle.skipped);
+        }
+        else {
+            // a row at a time, so a job that's been replaced stops within a row
+            for(int i=top; i<bottom; i++) {
+                if(generationCancelled())
+                    return;
+                escapeRow(formula, level, &column[first], row[i], count, &levels[(i - top)*count], view.juliaX, view.juliaY);
+            }
+        }
+        
+        float x0;
+        float y0;
+        vec3 color;
+        int entries[ESCAPE_TILE_WIDTH];
+        
+        for(int i=top; i<bottom; i++) {
+            if(rgba)
+                paletteRow(&levels[(i - top)*count], &column[first], row[i], shift, rise, count, entries);
+            
+            for(int j=0; j<count; j++) {
+                int remaining = levels[(i - top)*count + j];
+                if(remaining == REUSED)
+                    continue;
+                
+                if(points) {
+                    x0 = column[first + j];
+                    y0 = row[i];
+                    
+                    // some weird scaling stuff, I dunno
+                    x0 += shift;
+                    x0 /= 1.75;
+                    y0 += rise;
+                    y0 /= 1.5;
+                    
+                    if(remaining == 0)
+                        color = vec3(0.0, 0.0, 0.0);
+                    else
+                        color = mapColor(remaining, 360.0*x0+365.0, y0);
+                    
+                    size_t v = (size_t)i*width + first + j;
+                    points[v] = vec2(x0, y0);
+                    colors[v] = color;
+                }
+                if(known)
+                    known[(size_t)i*stride*width + (first + j)*stride] = remaining;
+                if(rgba) {
+                    // covering its block of the finished image
+                    const unsigned char* texel = palette.rgba[entries[j]];
+                    int x = (first + j)*stride;
+                    int y = i*stride;
+                    for(int by=y; by<std::min(y + stride, height); by++) {
+                        for(int bx=x; bx<std::min(x + stride, width); bx++)
+                            memcpy(rgba + 4*((size_t)by*width + bx), texel, 4);
+                    }
+                }
+            }
+        }
+        
+        // and whatever got iterated goes in the store for next time. Only that,
+        // since runs that don't subdivide get their texels from the same store
+        if(store && unknown) {
+            const vector<int>& filled = scratch[thread].tile.filled;
+            for(size_t r=0; r<filled.size(); r+=4) {
+                for(int i=filled[r+1]+1; i<filled[r+3]; i++)
+                    fill(&levels[i*count + filled[r] + 1], &levels[i*count + filled[r+2]], FILLED);
+            }
+            for(int i=top; i<bottom; i++)
+                writeTileStore(lattice, first*stride + corner + view.panX, i*stride + corner + view.panY, stride, count,
+                               &levels[(i - top)*count]);
+        }
+    });
+}
+
+// Antialiasing
+// One sample per pixel makes jagged steps along the edge of the set and of
+// every band, but most pixels aren't on an edge at all. So once an image is
+// finished, only the pixels whose neighbour escaped after a different number
+// of iterations (or didn't escape when they did, or the other way round) get
+// more samples. They start with 4, one in a jittered spot in each quarter of
+// the pixel and no two in the same row or column of a 4x4 grid over it. If
+// those 4 and the middle all agree the pixel is done, otherwise the other 12
+// cells of the grid get one each too. The pixel's color is the average of
+// the extra samples. The jitter goes by where the pixel is on the lattice, so
+// a pixel comes out the same whichever image it's in.
+//
+// Near the edge of the set nearly every pixel is on the edge of a band, and
+// they're the most expensive ones to iterate, so supersampling all of them
+// would cost several times the image itself. The extra samples get a budget
+// instead, AA_BUDGET of the work the image took (its iterations, plus the
+// coloring and so on every pixel needs), less what finding the edges takes,
+// and it goes to the pixels with the most contrast against their neighbours first.
+// It's a cap, but the samples are counted the same way as the pixels, so it's
+// also about what antialiasing costs. The samples are iterated in order of what
+// their pixels took, so ones that run the whole level don't hold up ones that
+// escape at once.
+bool escapeAntialias = false;
+
+const int AA_GRID = 4;                      // cells each way the pixel is split into
+const int AA_FIRST = 4;                     // samples everything on an edge gets
+// the cells in the order they get samples, the first AA_FIRST first
+const int AA_CELLS[AA_GRID*AA_GRID][2] = {{0, 1}, {1, 3}, {2, 0}, {3, 2},
+                                          {0, 0}, {1, 0}, {3, 0}, {1, 1}, {2, 1}, {3, 1},
+                                          {0, 2}, {1, 2}, {2, 2}, {0, 3}, {2, 3}, {3, 3}};
+const int AA_ROWS = 8;                      // rows of the image each tile of the search covers
+const int AA_BATCH = 256;                   // pixels each tile of the sampling does
+const double AA_BUDGET = 0.3;
+const int AA_PIXEL_WORK = 8;                // what every pixel (or sample) costs besides iterating, in iterations
+const int AA_SEARCH_WORK = 2;               // and what looking at it for edges (and sorting them) costs
+
+static atomic<long long> antialiasSamples(0);
+
+long long escapeAntialiasSamples() {
+    return antialiasSamples.load(memory_order_relaxed);
+}
+
+// how many iterations a pixel (or a sample) took, counting the ones that never
+// escaped as going all the way whether or not the interior checks stopped them
+static inline long long iterationsTaken(int level, int remaining) {
+    return remaining > 0 ? level - remaining : level;
+}
+
+// where in a pixel the sample in cell (a, b) goes, as an offset from the middle of the pixel
+static void jitterSample(long long p, long long q, int a, int b, double& x, double& y) {
+    unsigned long long hash = (unsigned long long)p*0x9e3779b97f4a7c15ull ^ (unsigned long long)q*0xc2b2ae3d27d4eb4full ^
+                              (unsigned long long)(b*AA_GRID + a)*0x165667b19e3779f9ull;
+    hash ^= hash >> 29;
+    hash *= 0xbf58476d1ce4e5b9ull;
+    hash ^= hash >> 32;
+    x = (a + (hash & 0xffff)/65536.0)/AA_GRID - 0.5;
+    y = (b + ((hash >> 16) & 0xffff)/65536.0)/AA_GRID - 0.5;
+}
+
+struct EdgePixel {
+    int pixel;                              // index into the image
+    bool agree;                             // the first samples all came out the same as the pixel
+    int sum[4];                             // of the colors of its samples so far
+    int samples;
+};
+
+// which pixels of a row aren't the same as all their neighbours (nonzero ones),
+// with the ones off the image counting as the pixel itself. It's xors rather
+// than compares so it's all ints, and blocks of 8 again, both for -O2
+static void edgeRow(const int* __restrict row, const int* __restrict above, const int* __restrict below, int width,
+                    int* __restrict edges) {
+    for(int j=0; j<width; j += std::max(width - 1, 1)) {
+        int pixel = row[j];
+        edges[j] = (row[std::max(j - 1, 0)] ^ pixel) | (row[std::min(j + 1, width - 1)] ^ pixel) |
+                   (above[j] ^ pixel) | (below[j] ^ pixel);
+    }
+    int j = 1;
+    for(; j + 8 <= width - 1; j += 8) {
+        for(int k=0; k<8; k++) {
+            int pixel = row[j + k];
+            edges[j + k] = (row[j + k - 1] ^ pixel) | (row[j + k + 1] ^ pixel) | (above[j + k] ^ pixel) | (below[j + k] ^ pixel);
+        }
+    }
+    for(; j<width - 1; j++)
+        edges[j] = (row[j - 1] ^ row[j]) | (row[j + 1] ^ row[j]) | (above[j] ^ row[j]) | (below[j] ^ row[j]);
+}
+
+// takes the samples in cells [from, to) of AA_CELLS for `count` edge pixels and
+// adds them into the pixels' sums, returning the work they took like the pixels'
+// is counted
+static long long sampleEdges(int formula, int level, int width, int height, const EscapeView& view, const DeepReference* reference, const int* levels,
+                             EdgePixel* edges, int count, int from, int to) {
+    const EscapeFrame& frame = escapeFormula(formula).frame;
+    double unitX = 3.5/(float)width/view.zoom;
+    double unitY = 3.0/(float)height/view.zoom;
+    double viewX = deepToDouble(view.x);
+    double viewY = deepToDouble(view.y);
+    int samples = count*(to - from);
+    vector<float> x(samples);
+    vector<float> y(samples);
+    vector<double> dx(reference ? samples : 0);
+    vector<double> dy(reference ? samples : 0);
+    vector<int> results(samples);
+    
+    // the kernel does its lanes together until the last one's done, and the
+    // edge pixels come in order of contrast, so a sample right by the set and
+    // one that escapes at once would often share lanes. Going by what the
+    // pixels themselves took keeps alike samples together. slot[e] is where
+    // edge e's samples go
+    vector<int> byLevel(count);
+    for(int e=0; e<count; e++)
+        byLevel[e] = e;
+    stable_sort(byLevel.begin(), byLevel.end(), [&](int a, int b) {
+        return iterationsTaken(level, levels[edges[a].pixel]) < iterationsTaken(level, levels[edges[b].pixel]);
+    });
+    vector<int> slot(count);
+    for(int r=0; r<count; r++)
+        slot[byLevel[r]] = r;
+    
+    for(int e=0; e<count; e++) {
+        // texel (j, i) is point (j + 1 + panX, i + 1 + panY) of the lattice
+        long long p = edges[e].pixel%width + 1 + view.panX;
+        long long q = edges[e].pixel/width + 1 + view.panY;
+        for(int c=from; c<to; c++) {
+            int s = slot[e]*(to - from) + c - from;
+            double ox, oy;
+            jitterSample(p, q, AA_CELLS[c][0], AA_CELLS[c][1], ox, oy);
+            x[s] = (float)(unitX*(p + ox) + frame.left + viewX);
+            y[s] = (float)(unitY*(q + oy) + frame.bottom + viewY);
+            if(reference) {
+                dx[s] = unitX*(p + ox - reference->j);
+                dy[s] = unitY*(q + oy - reference->i);
+            }
+        }
+    }
+    if(reference)
+        perturbPoints(reference->orbit, dx.data(), dy.data(), samples, results.data());
+    else
+        escapePoints(formula, level, x.data(), y.data(), samples, results.data(), view.juliaX, view.juliaY);
+    
+    // colored the same way the pixels themselves are
+    long long iterations = 0;
+    for(int e=0; e<count; e++) {
+        EdgePixel& edge = edges[e];
+        if(from == 0)
+            edge.agree = true;
+        for(int s=slot[e]*(to - from); s<(slot[e] + 1)*(to - from); s++) {
+            const unsigned char* texel = palette.rgba[paletteEntry(results[s], x[s], (y[s] + frame.rise())/1.5f, frame.shift())];
+            for(int c=0; c<4; c++)
+                edge.sum[c] += texel[c];
+            edge.samples++;
+            if(from == 0)
+                edge.agree = edge.agree && results[s] == levels[edge.pixel];
+            iterations += iterationsTaken(level, results[s]) + AA_PIXEL_WORK;
+        }
+    }
+    return iterations;
+}
+
+// takes cells [from, to) for the first `count` edge pixels on every core, and
+// returns the work that really took (less whatever the interior checks saved)
+static long long sampleRound(int formula, int level, int width, int height, const EscapeView& view, const DeepReference* reference, const int* levels,
+                             vector<EdgePixel>& edges, int count, int from, int to) {
+    long long skipped = escapeSkippedIterations();
+    atomic<long long> iterations(0);
+    runTiles((count + AA_BATCH - 1)/AA_BATCH, generatorThreads, [&](int batch) {
+        if(generationCancelled())
+            return;
+        int first = batch*AA_BATCH;
+        iterations += sampleEdges(formula, level, width, height, view, reference, levels,
+                                  &edges[first], std::min(AA_BATCH, count - first), from, to);
+    });
+    antialiasSamples.fetch_add((long long)count*(to - from), memory_order_relaxed);
+    return iterations - (escapeSkippedIterations() - skipped);
+}
+
+// supersamples the edge pixels of a finished image that are new since the last
+// call (fresh) or next to one that is, since a new neighbour can put a pixel on
+// an edge. `spent` is the work the new pixels took, in iterations
+static void antialiasImage(int formula, int level, int width, int height, const EscapeView& view,
+                           const vector<unsigned char>& fresh, long long spent, EscapeImage& image) {
+    const int* levels = image.levels.data();
+    const unsigned char* rgba = image.rgba.data();
+    
+    // the edge pixels and their contrast, found a band of rows at a time
+    int bands = (height + AA_ROWS - 1)/AA_ROWS;
+    vector<vector<int> > found(bands);      // pairs of pixel and contrast
+    runTiles(bands, generatorThreads, [&](int band) {
+        vector<int> edges(width);
+        for(int i=band*AA_ROWS; i<std::min((band + 1)*AA_ROWS, height); i++) {
+            const int* row = levels + (size_t)i*width;
+            int up = i + 1 < height ? width : 0;
+            int down = i > 0 ? -width : 0;
+            edgeRow(row, row + up, row + down, width, edges.data());
+            
+            const unsigned char* touched = &fresh[(size_t)i*width];
+            const unsigned char* texels = &rgba[4*(size_t)i*width];
+            for(int j=0; j<width; j++) {
+                if(!edges[j])
+                    continue;
+                int neighbours[4] = {j > 0 ? j - 1 : j, j + 1 < width ? j + 1 : j, j + up, j + down};
+                if(!(touched[j] | touched[neighbours[0]] | touched[neighbours[1]] | touched[neighbours[2]] |
+                     touched[neighbours[3]]))
+                    continue;
+                
+                int contrast = 0;
+                for(int n=0; n<4; n++) {
+                    if(row[neighbours[n]] == row[j])
+                        continue;
+                    const unsigned char* a = &texels[4*j];
+                    const unsigned char* b = &texels[4*neighbours[n]];
+                    contrast = std::max(contrast, abs(a[0] - b[0]) + abs(a[1] - b[1]) + abs(a[2] - b[2]));
+                }
+                found[band].push_back(i*width + j);
+                found[band].push_back(contrast);
+            }
+        }
+    });
+    
+    // highest contrast first, by counting sort since it's at most 3*255 (and
+    // pixels with the same contrast stay in order, so it comes out the same every time)
+    const int contrasts = 3*255 + 1;
+    vector<int> start(contrasts + 1, 0);    // where the pixels with each contrast (highest first) start
+    for(int band=0; band<bands; band++) {
+        for(size_t e=1; e<found[band].size(); e += 2)
+            start[contrasts - found[band][e]]++;
+    }
+    for(int c=1; c<=contrasts; c++)
+        start[c] += start[c - 1];
+    vector<int> order(start[contrasts]);
+    for(int band=0; band<bands; band++) {
+        for(size_t e=0; e<found[band].size(); e += 2)
+            order[start[contrasts - 1 - found[band][e + 1]]++] = found[band][e];
+    }
+    
+    // as many of the first samples as the budget has room for, going by what the
+    // pixels themselves took
+    long long budget = (long long)(AA_BUDGET*spent) - (long long)AA_SEARCH_WORK*width*height;
+    vector<EdgePixel> edges;
+    for(long long planned = 0; edges.size() < order.size(); ) {
+        planned += AA_FIRST*(iterationsTaken(level, levels[order[edges.size()]]) + AA_PIXEL_WORK);
+        if(planned > budget)
+            break;
+        EdgePixel edge = {order[edges.size()], false, {0, 0, 0, 0}, 0};
+        edges.push_back(edge);
+    }
+    if(edges.empty())
+        return;
+    int first = (int)edges.size();
+    
+    // too deep for floats, so the samples go by how far they are from the reference like the pixels do
+    const DeepReference* reference = 0;
+    if(view.zoom >= DEEP_ZOOM && escapeFormula(formula).perturbed) {
+        reference = findReference(formula, level, width, height, view);
+        if(!reference)
+            return;
+    }
+    
+    budget -= sampleRound(formula, level, width, height, view, reference, levels, edges, first, 0, AA_FIRST);
+    
+    // then the rest of the grid for as many of the ones that disagreed as what's left has room for
+    stable_partition(edges.begin(), edges.end(), [](const EdgePixel& edge) { return !edge.agree; });
+    int second = 0;
+    for(long long planned = 0; second < first && !edges[second].agree; second++) {
+        planned += (AA_GRID*AA_GRID - AA_FIRST)*(iterationsTaken(level, levels[edges[second].pixel]) + AA_PIXEL_WORK);
+        if(planned > budget)
+            break;
+    }
+    if(second > 0)
+        sampleRound(formula, level, width, height, view, reference, levels, edges, second, AA_FIRST,
+                    AA_GRID*AA_GRID);
+    if(generationCancelled())
+        return;
+    
+    for(int e=0; e<first; e++) {
+        const EdgePixel& edge = edges[e];
+        unsigned char* texel = &image.rgba[4*(size_t)edge.pixel];
+        for(int c=0; c<4; c++)
+            texel[c] = (unsigned char)((edge.sum[c] + edge.samples/2)/edge.samples);
+    }
+}
+
+void generateEscape(int formula, int level, int width, int height, vector<vec2>& points, vector<vec3>& colors) {
+    points.clear();
+    colors.clear();
+    if(width <= 0 || height <= 0)
+        return;
+    points.resize((size_t)width*height);
+    colors.resize((size_t)width*height);
+    escapeTiles(formula, level, width, height, EscapeView(), 1, 0, points.data(), colors.data(), 0);
+}
+
+// where on the lattice of a view texel j (or i) of the image sits, in units of the
+// lattice of another view, so texels can be looked up from one view to the other
+static double latticeX(const EscapeView& view, const EscapeView& from, int width, double j) {
+    double x = (3.5/width/view.zoom)*(j + 1 + view.panX) + deepToDouble(deepSub(view.x, from.x));
+    return x/(3.5/width/from.zoom) - 1 - from.panX;
+}
+
+static double latticeY(const EscapeView& view, const EscapeView& from, int height, double i) {
+    double y = (3.0/height/view.zoom)*(i + 1 + view.panY) + deepToDouble(deepSub(view.y, from.y));
+    return y/(3.0/height/from.zoom) - 1 - from.panY;
+}
+
+// Gets an image ready for a new view, keeping whatever it can of the old one.
+// A pan moves the texels (and what they iterated to) that are still on screen
+// to where they are now, which only costs a copy. Anything else has to be
+// iterated again from scratch, but the old image still makes a good preview:
+// it's scaled onto the new view (or kept as is for a new level) while every
+// texel is marked as not iterated yet.
+static void moveImage(EscapeImage& image, int formula, int level, int width, int height, const EscapeView& view) {
+    size_t pixels = (size_t)width*height;
+    bool similar = image.formula == formula && image.width == width && image.height == height;
+    if(similar && image.level == level && sameView(image.view, view))
+        return;
+    
+    if(!similar) {
+        image.rgba.assign(4*pixels, 0);
+        image.levels.assign(pixels, UNKNOWN);
+    }
+    else if(image.level == level && sameLattice(image.view, view)) {
+        int dx = view.panX - image.view.panX;
+        int dy = view.panY - image.view.panY;
+        
+        // texel (j, i) now shows what texel (j + dx, i + dy) did, moved in place
+        // in whichever order doesn't overwrite rows before they've been moved
+        int left = std::max(0, -dx);
+        int right = std::min(width, width - dx);
+        for(int k=0; k<height; k++) {
+            int i = dy > 0 ? k : height - 1 - k;
+            size_t to = (size_t)i*width;
+            if(i + dy < 0 || i + dy >= height || right <= left) {
+                memset(&image.rgba[4*to], 0, 4*(size_t)width);
+                fill(&image.levels[to], &image.levels[to] + width, UNKNOWN);
+                continue;
+            }
+            size_t from = (size_t)(i + dy)*width + dx;
+            memmove(&image.rgba[4*(to + left)], &image.rgba[4*(from + left)], 4*(right - left));
+            memmove(&image.levels[to + left], &image.levels[from + left], sizeof(int)*(right - left));
+            
+            // and the strips that just came on screen haven't been iterated
+            memset(&image.rgba[4*to], 0, 4*left);
+            fill(&image.levels[to], &image.levels[to] + left, UNKNOWN);
+            memset(&image.rgba[4*(to + right)], 0, 4*(width - right));
+            fill(&image.levels[to + right], &image.levels[to] + width, UNKNOWN);
+        }
+    }
+    else {
+        if(!sameLattice(image.view, view)) {
+            // nearest texel of the old image for every texel of the new one
+            vector<int> columns(width);
+            for(int j=0; j<width; j++)
+                columns[j] = (int)floor(latticeX(view, image.view, width, j) + 0.5);
+            vector<unsigned char> rgba(4*pixels, 0);
+            for(int i=0; i<height; i++) {
+                int from = (int)floor(latticeY(view, image.view, height, i) + 0.5);
+                if(from < 0 || from >= height)
+                    continue;
+                for(int j=0; j<width; j++) {
+                    if(columns[j] >= 0 && columns[j] < width)
+                        memcpy(&rgba[4*((size_t)i*width + j)], &image.rgba[4*((size_t)from*width + columns[j])], 4);
+                }
+            }
+            image.rgba.swap(rgba);
+        }
+        image.levels.assign(pixels, UNKNOWN);
+    }
+    
+    image.formula = formula;
+    image.level = level;
+    image.width = width;
+    image.height = height;
+    image.view = view;
+}
+
+void imageEscape(int formula, int level, int width, int height, const EscapeView& view, int stride,
+                 EscapeImage& image) {
+    moveImage(image, formula, level, width, height, view);
+    if(stride <= 0 || width <= 0 || height <= 0)
+        return;
+    
+    // only the finished image gets antialiased, and only where it's changed
+    bool antialias = escapeAntialias && stride == 1;
+    vector<unsigned char> fresh;
+    if(antialias) {
+        fresh.resize(image.levels.size());
+        for(size_t k=0; k<fresh.size(); k++)
+            fresh[k] = image.levels[k] == UNKNOWN;
+        antialias = find(fresh.begin(), fresh.end(), 1) != fresh.end();
+    }
+    long long skipped = escapeSkippedIterations();
+    escapeTiles(formula, level, width, height, view, stride, image.levels.data(), 0, 0, image.rgba.data());
+    if(!antialias || generationCancelled())
+        return;
+    
+    // what the new pixels took goes into the budget for antialiasing them
+    long long spent = skipped - escapeSkippedIterations();
+    for(size_t k=0; k<fresh.size(); k++) {
+        if(fresh[k])
+            spent += iterationsTaken(level, image.levels[k]) + AA_PIXEL_WORK;
+    }
+    antialiasImage(formula, level, width, height, view, fresh, spent, image);
+}
+
+long imageSamples(const EscapeImage& image, int stride) {
+    long samples = 0;
+    for(int i=0; i<image.height; i += stride) {
+        const int* levels = &image.levels[(size_t)i*image.width];
+        for(int j=0; j<image.width; j += stride)
+            samples += levels[j] == UNKNOWN;
+    }
+    return samples;
+}
+
+// --------------------------------------------------------------------------
+// Julia set outline
+
+const int OUTLINE_HITS = 4;                 // times a texel's point gets its preimages taken
+const int OUTLINE_CELLS = 8;                // the texels counted can be at most this many times the image's
+const int OUTLINE_POLL = 4096;              // points between checks for cancellation
+
+// The Julia set is where the preimages of any point of it pile up, so taking
+// the two square roots of z - c over and over from its repelling fixed point
+// walks all over it (the modified inverse iteration method). Most of the tree
+// of preimages lands on the same few places though, so every texel only has
+// the preimages of its points taken OUTLINE_HITS times and the branches that
+// land on a full one are cut off. That makes it take about as long as the set
+// is long, however many levels the escape-time image has. The texels are
+// counted over the whole set (the set's preimages are spread all over it, even
+// the ones that land on screen), so it gives up when that's too many.
+bool outlineJulia(int width, int height, const EscapeView& view, vector<unsigned char>& rgba) {
+    if(width <= 0 || height <= 0)
+        return false;
+    double cx = view.juliaX;
+    double cy = view.juliaY;
+    double unitX = 3.5/(float)width/view.zoom;
+    double unitY = 3.0/(float)height/view.zoom;
+    // where the middle of texel 0 is, and how far out the set can reach
+    const EscapeFrame& frame = escapeFormula(ESCAPE::JULIA).frame;
+    double x0 = unitX*(1 + view.panX) + frame.left + deepToDouble(view.x);
+    double y0 = unitY*(1 + view.panY) + frame.bottom + deepToDouble(view.y);
+    double radius = 0.5 + sqrt(0.25 + sqrt(cx*cx + cy*cy));
+    
+    long long left = std::min(0.0, floor((-radius - x0)/unitX + 0.5));
+    long long bottom = std::min(0.0, floor((-radius - y0)/unitY + 0.5));
+    long long across = std::max((double)width, ceil((radius - x0)/unitX + 0.5)) - left;
+    long long down = std::max((double)height, ceil((radius - y0)/unitY + 0.5)) - bottom;
+    if(across*down > (long long)OUTLINE_CELLS*width*height)
+        return false;
+    vector<unsigned char> hits((size_t)(across*down), 0);
+    
+    // the repelling fixed point, 1/2 + sqrt(1/4 - c)
+    double ax = 0.25 - cx;
+    double ay = -cy;
+    double r = sqrt(ax*ax + ay*ay);
+    vector<dvec2> stack(1, dvec2(0.5 + sqrt(0.5*(r + ax)), copysign(sqrt(0.5*(r - ax)), ay)));
+    for(long polled = 0; !stack.empty(); polled++) {
+        if(polled % OUTLINE_POLL == 0 && generationCancelled())
+            return false;
+        dvec2 z = stack.back();
+        stack.pop_back();
+        double u = floor((z.x - x0)/unitX + 0.5) - left;
+        double v = floor((z.y - y0)/unitY + 0.5) - bottom;
+        if(!(u >= 0 && u < across && v >= 0 && v < down))
+            continue;
+        unsigned char& count = hits[(size_t)v*across + (size_t)u];
+        if(count >= OUTLINE_HITS)
+            continue;
+        count++;
+        
+        // the preimages are +-sqrt(z - c)
+        ax = z.x - cx;
+        ay = z.y - cy;
+        r = sqrt(ax*ax + ay*ay);
+        dvec2 w(sqrt(0.5*(r + ax)), copysign(sqrt(0.5*(r - ax)), ay));
+        stack.push_back(w);
+        stack.push_back(-w);
+    }
+    
+    // white where the set is, fading out where it was barely reached
+    rgba.assign(4*(size_t)width*height, 0);
+    for(int i=0; i<height; i++) {
+        const unsigned char* row = &hits[(size_t)(i - bottom)*across - left];
+        for(int j=0; j<width; j++) {
+            unsigned char* texel = &rgba[4*((size_t)i*width + j)];
+            unsigned char shade = (unsigned char)(255*row[j]/OUTLINE_HITS);
+            texel[0] = texel[1] = texel[2] = shade;
+            texel[3] = 255;
+        }
+    }
+    return true;
+}
+
+// --------------------------------------------------------------------------
+// Buddhabrot
+
+const int BUDDHABROT_SAMPLES = 8;           // orbits per texel of the finished image
+const double BUDDHABROT_WHITE = 0.995;      // how many texels come out darker than white
+
+// The Buddhabrot images are on the same lattice as the Mandelbrot set's, with
+// each texel counting the orbits that pass through the square around it. The
+// histogram keeps filling up as long as the image stays the same, so every
+// pass only runs the orbits the one before it didn't, and a pass with stride s
+// sums s x s blocks of it (the same number of orbits per block whatever the
+// stride). Only touched by whoever's making images, one at a time
+struct Buddhabrot {
+    int orbits;                             // ORBITS it was made with, -1 before the first
+    int level;
+    int width;
+    int height;
+    EscapeView view;
+    vector<float> density;
+    long long samples;                      // how many orbits have gone into it
+    
+    Buddhabrot() : orbits(-1), level(0), width(0), height(0), samples(0) {}
+};
+
+static Buddhabrot buddhabrot;
+
+// from black through blue to white
+struct BuddhabrotRamp {
+    unsigned char rgba[256][4];
+    
+    BuddhabrotRamp() {
+        for(int k=0; k<256; k++) {
+            double v = k/255.0;
+            rgba[k][0] = (unsigned char)(255.0*pow(v, 1.2) + 0.5);
+            rgba[k][1] = (unsigned char)(255.0*v + 0.5);
+            rgba[k][2] = (unsigned char)(255.0*pow(v, 0.8) + 0.5);
+            rgba[k][3] = 255;
+        }
+    }
+};
+
+static const BuddhabrotRamp buddhabrotRamp;
+
+static void imageOrbits(int orbits, int level, int width, int height, const EscapeView& view, int stride,
+                        EscapeImage& image) {
+    // formulas past the escape-time ones, so moveImage doesn't mix the images up
+    moveImage(image, ESCAPE::COUNT + orbits, level, width, height, view);
+    Buddhabrot& b = buddhabrot;
+    if(b.orbits != orbits || b.level != level || b.width != width || b.height != height || !sameView(b.view, view)) {
+        // any change at all moves every orbit, so the histogram starts over
+        // (with the old image still there as a preview)
+        b.orbits = orbits;
+        b.level = level;
+        b.width = width;
+        b.height = height;
+        b.view = view;
+        b.density.assign((size_t)width*height, 0.0f);
+        b.samples = 0;
+        fill(image.levels.begin(), image.levels.end(), UNKNOWN);
+    }
+    if(stride <= 0 || width <= 0 || height <= 0 || imageSamples(image, stride) == 0)
+        return;
+    
+    long long target = (long long)BUDDHABROT_SAMPLES*width*height/((long long)stride*stride);
+    if(target > b.samples) {
+        DensityGrid grid;
+        grid.width = width;
+        grid.height = height;
+        grid.unitX = 3.5/width/view.zoom;
+        grid.unitY = 3.0/height/view.zoom;
+        const EscapeFrame& frame = escapeFormula(ESCAPE::MANDELBROT).frame;
+        grid.left = frame.left + deepToDouble(view.x) + grid.unitX*(0.5 + view.panX);
+        grid.bottom = frame.bottom + deepToDouble(view.y) + grid.unitY*(0.5 + view.panY);
+        if(!sampleOrbits(orbits, level, grid, target - b.samples, (unsigned int)b.samples, generatorThreads, b.density,
+                         generationCancelled))
+            return;
+        b.samples = target;
+    }
+    
+    // every texel of the pass stands for the block above and to the right of it
+    int across = (width + stride - 1)/stride;
+    int down = (height + stride - 1)/stride;
+    vector<float> blocks((size_t)across*down);
+    for(int i=0; i<down; i++) {
+        for(int j=0; j<across; j++) {
+            int x1 = std::min((j + 1)*stride, width);
+            int y1 = std::min((i + 1)*stride, height);
+            double sum = 0.0;
+            for(int y=i*stride; y<y1; y++) {
+                for(int x=j*stride; x<x1; x++)
+                    sum += b.density[(size_t)y*width + x];
+            }
+            blocks[(size_t)i*across + j] = (float)(sum/((x1 - j*stride)*(y1 - i*stride)));
+        }
+    }
+    
+    // a few very bright texels would leave the rest too dark to see, so they
+    // saturate, and a gamma below 1 brings the faint orbits up a bit
+    vector<float> sorted(blocks);
+    size_t bright = std::min(sorted.size() - 1, (size_t)(BUDDHABROT_WHITE*sorted.size()));
+    nth_element(sorted.begin(), sorted.begin() + bright, sorted.end());
+    float white = sorted[bright];
+    if(white <= 0.0f)
+        white = *max_element(blocks.begin(), blocks.end());
+    float scale = white > 0.0f ? 1.0f/white : 0.0f;
+    
+    for(int i=0; i<down; i++) {
+        for(int j=0; j<across; j++) {
+            float v = std::min(pow(blocks[(size_t)i*across + j]*scale, 0.75f), 1.0f);
+            const unsigned char* texel = buddhabrotRamp.rgba[(int)(255.0f*v + 0.5f)];
+            for(int y=i*stride; y<std::min((i + 1)*stride, height); y++) {
+                for(int x=j*stride; x<std::min((j + 1)*stride, width); x++)
+                    memcpy(&image.rgba[4*((size_t)y*width + x)], texel, 4);
+            }
+            // nothing's left to iterate there, as far as imageSamples is concerned
+            image.levels[(size_t)i*stride*width + (size_t)j*stride] = 0;
+        }
+    }
+}
+
+// as points, one per pixel where the Mandelbrot set would put them
+static void generateOrbits(int orbits, int level, int width, int height, vector<vec2>& points, vector<vec3>& colors) {
+    points.clear();
+    colors.clear();
+    if(width <= 0 || height <= 0)
+        return;
+    // from scratch, like every other generator, rather than from what the image has run so far
+    buddhabrot.orbits = -1;
+    EscapeImage image;
+    imageOrbits(orbits, level, width, height, EscapeView(), 1, image);
+    points.resize((size_t)width*height);
+    colors.resize((size_t)width*height);
+    for(int i=0; i<height; i++) {
+        for(int j=0; j<width; j++) {
+            // point (j, i) is on the same spot as texel (j - 1, i - 1)
+            size_t v = (size_t)i*width + j;
+            points[v] = vec2(2.0f*j/width - 1.0f, 2.0f*i/height - 1.0f);
+            colors[v] = vec3(0.0, 0.0, 0.0);
+            if(i > 0 && j > 0) {
+                const unsigned char* texel = &image.rgba[4*((size_t)(i - 1)*width + j - 1)];
+                colors[v] = vec3(texel[0]/255.0f, texel[1]/255.0f, texel[2]/255.0f);
+            }
+        }
+    }
+}
+
+void generateBuddhabrot(int level, int width, int height, vector<vec2>& points, vector<vec3>& colors) {
+    generateOrbits(ORBITS::ESCAPING, level, width, height, points, colors);
+}
+
+void generateAntiBuddhabrot(int level, int width, int height, vector<vec2>& points, vector<vec3>& colors) {
+    generateOrbits(ORBITS::TRAPPED, level, width, height, points, colors);
+}
+
+void imageBuddhabrot(int level, int width, int height, const EscapeView& view, int stride, EscapeImage& image) {
+    imageOrbits(ORBITS::ESCAPING, level, width, height, view, stride, image);
+}
+
+void imageAntiBuddhabrot(int level, int width, int height, const EscapeView& view, int stride, EscapeImage& image) {
+    imageOrbits(ORBITS::TRAPPED, level, width, height, view, stride, image);
+}
+
+// --------------------------------------------------------------------------
+// Views
+
+bool sameLattice(const EscapeView& a, const EscapeView& b) {
+    return a.zoom == b.zoom && deepEqual(a.x, b.x) && deepEqual(a.y, b.y) && a.juliaX == b.juliaX && a.juliaY == b.juliaY;
+}
+
+bool sameView(const EscapeView& a, const EscapeView& b) {
+    return sameLattice(a, b) && a.panX == b.panX && a.panY == b.panY;
+}
+
+EscapeView zoomView(const EscapeView& view, int width, int height, double j, double i, double factor) {
+    // the new lattice starts at texel 0 with the point under (j, i) still under it,
+    // worked out in fixed point so it stays put however deep the view is
+    EscapeView zoomed;
+    zoomed.juliaX = view.juliaX;
+    zoomed.juliaY = view.juliaY;
+    zoomed.zoom = std::min(view.zoom*factor, DEEP_MAX_ZOOM);
+    DeepFixed from = deepMul(deepFromDouble(3.5/width/view.zoom), deepFromDouble(j + 1 + view.panX));
+    DeepFixed to = deepMul(deepFromDouble(3.5/width/zoomed.zoom), deepFromDouble(j + 1));
+    zoomed.x = deepAdd(view.x, deepSub(from, to));
+    from = deepMul(deepFromDouble(3.0/height/view.zoom), deepFromDouble(i + 1 + view.panY));
+    to = deepMul(deepFromDouble(3.0/height/zoomed.zoom), deepFromDouble(i + 1));
+    zoomed.y = deepAdd(view.y, deepSub(from, to));
+    return zoomed;
+}
+
+// --------------------------------------------------------------------------
+// Scene registry
+
+// the table only has one signature for generators, so these adapt the ones that
+// don't care about the framebuffer size
+static void squaresScene(int level, int, int, vector<vec2>& points, vector<vec3>& colors) { generateSquares(level, points, colors); }
+static void spiralScene(int level, int, int, vector<vec2>& points, vector<vec3>& colors) { generateSpiral(level, points, colors); }
+static void sierpinskiScene(int level, int, int, vector<vec2>& points, vector<vec3>& colors) { generateSierpinski(level, points, colors); }
+static void fernScene(int level, int, int, vector<vec2>& points, vector<vec3>& colors) { generateFern(level, points, colors); }
+static void dragonScene(int level, int, int, vector<vec2>& points, vector<vec3>& colors) { generateDragon(level, points, colors); }
+
+// Stepping between levels
+// the squares and the fern only ever append, so lower levels are a prefix of
+// higher ones and stepping down just drops the vertices of the levels above `to`
+static bool truncateLevels(size_t perLevel, int to, vector<vec2>& points, vector<vec3>& colors) {
+    size_t count = std::max(to, 0)*perLevel;
+    if(count == 0 || count > points.size())
+        return false;
+    
+    points.resize(count);
+    colors.resize(count);
+    return true;
+}
+static bool squaresTruncate(int to, vector<vec2>& points, vector<vec3>& colors) { return truncateLevels(16, to, points, colors); }
+static bool fernTruncate(int to, vector<vec2>& points, vector<vec3>& colors) { return truncateLevels(50000, to, points, colors); }
+
+// stepping up only needs the tail end of the previous level's geometry: nothing
+// for the squares, the last point for the fern (the chaos game carries on from it)
+// and the whole curve for the dragon since every segment gets folded again
+static long squaresContext(int, int, size_t) { return 0; }
+static long fernContext(int, int, size_t count) { return std::min(count, (size_t)1); }
+static long dragonContext(int from, int, size_t count) { return from >= 1 ? (long)count : -1; }
+
+// the new levels only add vertices to the squares and the fern, but folding
+// moves every vertex of the dragon (it's still cheaper than starting over)
+static size_t squaresStep(int from, int to, vector<vec2>& points, vector<vec3>& colors) {
+    size_t first = points.size();
+    extendSquares(from, to, points, colors);
+    return first;
+}
+static size_t fernStep(int from, int to, vector<vec2>& points, vector<vec3>& colors) {
+    size_t first = points.size();
+    extendFern(from, to, points, colors);
+    return first;
+}
+static size_t dragonStep(int from, int to, vector<vec2>& points, vector<vec3>& colors) {
+    extendDragon(from, to, points, colors);
+    return 0;
+}
+
+// closed-form vertex counts, in doubles so the exponential ones can't overflow
+static double squaresVertices(int level, int, int) {
+    return 16.0*level;                      // 4 lines for the square and 4 for the diamond
+}
+static double spiralVertices(int level, int, int) {
+    return ceil(level*2*M_PI/0.01);         // one point every 0.01 radians
+}
+static double sierpinskiVertices(int level, int, int) {
+    return 3*pow(3.0, level);               // a triangle per leaf
+}
+static double fernVertices(int level, int, int) {
+    return 50000.0*level;
+}
+static double dragonVertices(int level, int, int) {
+    return level <= 1 ? 2 : pow(2.0, level-1) + 1;
+}
+static double pixelVertices(int, int width, int height) {
+    return (double)width*height;            // one point per pixel, whatever the level
+}
+
+// an escape-time image is its RGBA texels and how many iterations each had left
+static double escapeImageBytes(int width, int height) {
+    return (double)width*height*(4 + sizeof(int));
+}
+
+// and a Buddhabrot image also has the density, a histogram for every thread
+// to add its orbits to, and the blocks (and a sorted copy) it's colored from
+static double orbitImageBytes(int width, int height) {
+    return escapeImageBytes(width, height) + (double)width*height*sizeof(float)*(tileThreads(generatorThreads) + 3);
+}
+
+// the escape-time sets do up to `level` iterations per pixel, the rest do a
+// roughly constant amount of work per vertex
+static double pixelIterations(int level, int width, int height) {
+    return (double)width*height*std::max(level, 1);
+}
+
+// and the Buddhabrots run BUDDHABROT_SAMPLES orbits a pixel, mostly long ones
+static double orbitIterations(int level, int width, int height) {
+    return BUDDHABROT_SAMPLES*pixelIterations(level, width, height);
+}
+
+// an escape-time set's row, from its line in ESCAPE_FORMULAS
+#define FORMULA_SCENE(name, policy, scene) \
+    {scene, PRIMITIVE::POINTS, generateFormula<ESCAPE::name>, imageFormula<ESCAPE::name>, escapeImageBytes, pixelVertices, pixelIterations},
+#define NO_SCENE(name, policy, scene)
+
+const SceneInfo sceneTable[] = {
+    {"Squares and Triangles", PRIMITIVE::LINES,      squaresScene,           0,                   0,                squaresVertices,    squaresVertices,
+                                                     squaresTruncate,        squaresContext,      squaresStep},
+    {"Archimedes' Spiral",    PRIMITIVE::LINE_STRIP, spiralScene,            0,                   0,                spiralVertices,     spiralVertices},
+    {"Sierpinski Triangle",   PRIMITIVE::TRIANGLES,  sierpinskiScene,        0,                   0,                sierpinskiVertices, sierpinskiVertices},
+    {"Barnsley's Fern",       PRIMITIVE::POINTS,     fernScene,              0,                   0,                fernVertices,       fernVertices,
+                                                     fernTruncate,           fernContext,         fernStep},
+    {"Heighway Dragon Curve", PRIMITIVE::LINE_STRIP, dragonScene,            0,                   0,                dragonVertices,     dragonVertices,
+                                                     0,                      dragonContext,       dragonStep},
+    ESCAPE_FORMULAS(FORMULA_SCENE, NO_SCENE)
+    {"Buddhabrot",            PRIMITIVE::POINTS,     generateBuddhabrot,     imageBuddhabrot,     orbitImageBytes,  pixelVertices,      orbitIterations},
+    {"Anti-Buddhabrot",       PRIMITIVE::POINTS,     generateAntiBuddhabrot, imageAntiBuddhabrot, orbitImageBytes,  pixelVertices,      orbitIterations},
+    ESCAPE_FORMULAS(NO_SCENE, FORMULA_SCENE)
+};
+
+const int sceneCount = sizeof(sceneTable)/sizeof(sceneTable[0]);
+
+const SceneInfo* findScene(int scene) {
+    if(scene < 1 || scene > sceneCount)
+        return 0;
+    return &sceneTable[scene-1];
+}
+
+double estimateVertices(int scene, int level, int width, int height) {
+    const SceneInfo* info = findScene(scene);
+    return info ? info->vertices(std::max(level, 0), width, height) : 0.0;
+}
+
+double estimateBytes(int scene, int level, int width, int height) {
+    return estimateVertices(scene, level, width, height)*(sizeof(vec2) + sizeof(vec3));
+}
+
+double estimateImageBytes(int scene, int width, int height) {
+    const SceneInfo* info = findScene(scene);
+    return info && info->image ? info->imageBytes(width, height) : 0.0;
+}
+
+double estimateWork(int scene, int level, int width, int height) {
+    const SceneInfo* info = findScene(scene);
+    return info ? info->work(std::max(level, 0), width, height) : 0.0;
+}
+
+bool truncateScene(int scene, int to, vector<vec2>& points, vector<vec3>& colors) {
+    const SceneInfo* info = findScene(scene);
+    return info && info->truncate && info->truncate(to, points, colors);
+}
+
+long stepContext(int scene, int from, int to, size_t count) {
+    const SceneInfo* info = findScene(scene);
+    if(!info || !info->context || !info->step || to <= from)
+        return -1;
+    return info->context(from, to, count);
+}
+
+// points and colors hold (at least) the vertices asked for by stepContext
+bool stepScene(int scene, int from, int to, vector<vec2>& points, vector<vec3>& colors, size_t& firstChanged) {
+    firstChanged = points.size();
+    if(stepContext(scene, from, to, points.size()) < 0)
+        return false;
+    
+    firstChanged = findScene(scene)->step(from, to, points, colors);
+    return true;
+}
+
+// generates a scene from scratch and returns the primitive type to draw it with
+int generateScene(int scene, int level, int width, int height, vector<vec2>& points, vector<vec3>& colors) {
+    const SceneInfo* info = findScene(scene);
+    if(!info) {
+        points.clear();
+        colors.clear();
+        return PRIMITIVE::POINTS;
+    }
+    
+    info->generate(level, width, height, points, colors);
+    return info->primitive;
+}
@@ -0,0 +1,183 @@
+// ==========================================================================
+// Scene generators
+//
+// Each generator fills points/colors with the vertices of one scene at a
+// given level. They only depend on glm, not on OpenGL or GLFW.
+//
+// Modifications and additional functionality by Cameron Hardy (ID 10084560)
+// ==========================================================================
+
+#ifndef GENERATORS_H
+#define GENERATORS_H
+
+#include <atomic>
+#include <vector>
+#include "glm/glm.hpp"
+#include "deepzoom.h"
+#include "escapetime.h"
+
+// the primitive types the scenes are drawn with, matching GL_LINES, GL_LINE_STRIP, GL_TRIANGLES and GL_POINTS
+struct PRIMITIVE{
+    enum {LINES=0, LINE_STRIP, TRIANGLES, POINTS, COUNT};
+};
+
+// Cancellation
+// requestedJob is bumped by whoever wants something newer, runningJob is the job
+// the calling thread is working on; the slow generators poll generationCancelled()
+extern std::atomic<int> requestedJob;
+extern int runningJob;
+bool generationCancelled();
+
+// Threads
+// how many threads the Mandelbrot and Julia sets are split across, <= 0 is one per core
+extern int generatorThreads;
+// fill in the Mandelbrot and Julia sets by Mariani-Silver subdivision instead of
+// iterating every pixel
+extern bool escapeSubdivide;
+// supersample the pixels of the Mandelbrot and Julia set images that are on the
+// edge of the set or of a band, and how many extra samples that's taken since
+// the program started
+extern bool escapeAntialias;
+long long escapeAntialiasSamples();
+
+// Scenes
+void generateSquares(int level, std::vector<glm::vec2>& points, std::vector<glm::vec3>& colors);
+void generateSpiral(int level, std::vector<glm::vec2>& points, std::vector<glm::vec3>& colors);
+void generateSierpinski(int level, std::vector<glm::vec2>& points, std::vector<glm::vec3>& colors);
+void generateFern(int level, std::vector<glm::vec2>& points, std::vector<glm::vec3>& colors);
+void generateDragon(int level, std::vector<glm::vec2>& points, std::vector<glm::vec3>& colors);
+// the Mandelbrot and Julia sets, or whichever ESCAPE formula it is
+void generateEscape(int formula, int level, int width, int height, std::vector<glm::vec2>& points, std::vector<glm::vec3>& colors);
+void generateBuddhabrot(int level, int width, int height, std::vector<glm::vec2>& points, std::vector<glm::vec3>& colors);
+void generateAntiBuddhabrot(int level, int width, int height, std::vector<glm::vec2>& points, std::vector<glm::vec3>& colors);
+
+// Views
+// which part of the plane the Mandelbrot and Julia set images show. At zoom 1
+// the window covers the whole set, 3.5 wide and 3 high, and zoom 2 covers half
+// that. Texel (j, i) sits on point (j + panX, i + panY) of a lattice that's
+// scaled by the zoom and moved (x, y) across the plane, so panning by whole
+// pixels leaves every texel that stays on screen on exactly the same point.
+// (x, y) is kept in fixed point since a double can't say where a pixel is once
+// the zoom gets past about 1e13, and past DEEP_ZOOM the images are made by
+// perturbation (see deepzoom.h). The Julia set also takes its c from the view
+struct EscapeView {
+    double zoom;
+    DeepFixed x;
+    DeepFixed y;
+    int panX;
+    int panY;
+    double juliaX;
+    double juliaY;
+    
+    EscapeView() : zoom(1.0), panX(0), panY(0), juliaX(JULIA_X), juliaY(JULIA_Y) {}
+};
+
+// same lattice means the views only differ by a pan (and have the same c)
+bool sameLattice(const EscapeView& a, const EscapeView& b);
+bool sameView(const EscapeView& a, const EscapeView& b);
+// the view zoomed in by `factor` about the point under texel (j, i), which stays where it is
+// (up to DEEP_MAX_ZOOM)
+EscapeView zoomView(const EscapeView& view, int width, int height, double j, double i, double factor);
+
+// Images
+// the escape-time scenes can also be made as an RGBA8 image with one texel per
+// pixel (4 bytes instead of a 20 byte vertex), row 0 at the bottom like a GL texture
+//
+// The image remembers how many iterations every texel had left, so the next
+// call only iterates what it has to. Asking for the same image again carries
+// on where the last call left off, a pan shifts the texels that are still on
+// screen into place so only the newly exposed strips get iterated, and a new
+// zoom or level starts over (from a scaled copy of the old image as a preview).
+//
+// They can be made coarse to fine, a pass at a time. A pass with stride s (a
+// power of two) only iterates every s-th texel each way and paints each one
+// over the s x s block above and to the right of it, so stride 4 is 1/16 of
+// the texels, 2 is 1/4 and 1 is the finished image. Stride 0 just moves the
+// image onto the view without iterating anything.
+struct EscapeImage {
+    int formula;                            // ESCAPE formula it was made with, -1 before the first
+    int level;
+    int width;
+    int height;
+    EscapeView view;
+    std::vector<unsigned char> rgba;
+    std::vector<int> levels;                // iterations each texel had left, -1 if it hasn't been iterated
+    
+    EscapeImage() : formula(-1), level(0), width(0), height(0) {}
+};
+
+void imageEscape(int formula, int level, int width, int height, const EscapeView& view, int stride, EscapeImage& image);
+// the same for one formula, which is what its scene's row points at
+template<int formula>
+void generateFormula(int level, int width, int height, std::vector<glm::vec2>& points, std::vector<glm::vec3>& colors) {
+    generateEscape(formula, level, width, height, points, colors);
+}
+template<int formula>
+void imageFormula(int level, int width, int height, const EscapeView& view, int stride, EscapeImage& image) {
+    imageEscape(formula, level, width, height, view, stride, image);
+}
+// the Buddhabrot and anti-Buddhabrot (see buddhabrot.h) on the Mandelbrot set's
+// lattice; the finer passes add orbits to what the coarser ones ran
+void imageBuddhabrot(int level, int width, int height, const EscapeView& view, int stride, EscapeImage& image);
+void imageAntiBuddhabrot(int level, int width, int height, const EscapeView& view, int stride, EscapeImage& image);
+// how many texels a pass with this stride still has to iterate
+long imageSamples(const EscapeImage& image, int stride);
+// a quick outline of the Julia set on the view by inverse iteration, to show
+// while the escape-time image is made. It takes about as long as the set is
+// long, whatever the level. False (with rgba left alone) if the view is zoomed
+// in too far for it or it was cancelled
+bool outlineJulia(int width, int height, const EscapeView& view, std::vector<unsigned char>& rgba);
+
+// Scene registry
+// every scene the app knows about, numbered from 1 in table order. Adding a
+// scene is just another row here: the keys, the worker, the stepping between
+// levels and the headless renderer all go through the table. The escape-time
+// sets' rows are made from ESCAPE_FORMULAS (see escapetime.h)
+struct SceneInfo {
+    const char* name;
+    int primitive;                          // PRIMITIVE type to draw it with
+    void (*generate)(int level, int width, int height, std::vector<glm::vec2>& points, std::vector<glm::vec3>& colors);
+    void (*image)(int level, int width, int height, const EscapeView& view, int stride, EscapeImage& image);   // null unless it can be drawn as an image
+    double (*imageBytes)(int width, int height);                // memory making that image takes, the image included
+    double (*vertices)(int level, int width, int height);       // closed-form estimate of how many vertices generate makes
+    double (*work)(int level, int width, int height);           // and of how much computation that takes, in arbitrary units
+    
+    // stepping between levels without starting over, each null if the scene can't
+    // drops the vertices above level `to`, false if it can't from what's there
+    bool (*truncate)(int to, std::vector<glm::vec2>& points, std::vector<glm::vec3>& colors);
+    // how many of the last `count` vertices of level `from` step needs to reach level `to`, or -1
+    long (*context)(int from, int to, size_t count);
+    // turns (the tail end of) level `from` into level `to`, returning the first vertex that changed
+    size_t (*step)(int from, int to, std::vector<glm::vec2>& points, std::vector<glm::vec3>& colors);
+};
+
+extern const SceneInfo sceneTable[];
+extern const int sceneCount;
+
+// the registry entry for scene 1..sceneCount, or null
+const SceneInfo* findScene(int scene);
+// what a scene will cost before generating it
+double estimateVertices(int scene, int level, int width, int height);
+double estimateBytes(int scene, int level, int width, int height);
+double estimateImageBytes(int scene, int width, int height);              // 0 for scenes without an image, else
+                                                                          // the image and everything it's made with
+double estimateWork(int scene, int level, int width, int height);
+
+// generates a scene from scratch and returns the PRIMITIVE type to draw it with
+int generateScene(int scene, int level, int width, int height, std::vector<glm::vec2>& points, std::vector<glm::vec3>& colors);
+
+// Incremental generation
+// extendX turns geometry generated for level `from` into level `to`
+void extendSquares(int from, int to, std::vector<glm::vec2>& points, std::vector<glm::vec3>& colors);
+void extendFern(int from, int to, std::vector<glm::vec2>& points, std::vector<glm::vec3>& colors);
+void extendDragon(int from, int to, std::vector<glm::vec2>& points, std::vector<glm::vec3>& colors);
+
+// these go through the scene's row of the table
+// steps a scene down to level `to` by dropping vertices, if its lower levels are a prefix of higher ones
+bool truncateScene(int scene, int to, std::vector<glm::vec2>& points, std::vector<glm::vec3>& colors);
+// how many of the last `count` vertices of level `from` stepScene needs to reach level `to`, or -1 if it can't
+long stepContext(int scene, int from, int to, size_t count);
+// steps a scene up from level `from` to `to`; firstChanged is the first vertex that changed
+bool stepScene(int scene, int from, int to, std::vector<glm::vec2>& points, std::vector<glm::vec3>& colors, size_t& firstChanged);
+
+#endif
@@ -0,0 +1,22 @@
+// ==========================================================================
+// Fragment program for the scenes drawn as an image
+//
+// Looks up the texel under each pixel. The texture is the size of the window
+// and filtered with GL_NEAREST, so every pixel gets exactly one texel.
+// ==========================================================================
+#version 330
+
+// interpolated texture coordinate received from vertex stage
+in vec2 TextureCoord;
+
+// the scene, one RGBA8 texel per pixel
+uniform sampler2D Image;
+
+// first output is mapped to the framebuffer's colour index by default
+out vec4 FragmentColour;
+
+void main(void)
+{
+    // same as fragment.glsl, the alpha channel isn't used
+    FragmentColour = vec4(texture(Image, TextureCoord).rgb, 0);
+}
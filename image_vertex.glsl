@@ -0,0 +1,19 @@
+// ==========================================================================
+// Vertex program for the scenes drawn as an image
+//
+// Makes a quad covering the whole window out of nothing but gl_VertexID, so
+// drawing 4 vertices as a triangle strip needs no vertex buffers at all.
+// ==========================================================================
+#version 330
+
+// texture coordinate of this corner, (0, 0) at the bottom left
+out vec2 TextureCoord;
+
+void main()
+{
+    // vertices 0-3 are the corners (0, 0), (1, 0), (0, 1), (1, 1)
+    vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1);
+    gl_Position = vec4(corner*2.0 - 1.0, 0.0, 1.0);
+
+    TextureCoord = corner;
+}
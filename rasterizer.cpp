@@ -0,0 +1,451 @@
+// ==========================================================================
+// Headless CPU rasterizer
+//
+// Modifications and additional functionality by Cameron Hardy (ID 10084560)
+// ==========================================================================
+
+#include "rasterizer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <fstream>
+#include <thread>
+
+using namespace std;
+using namespace glm;
+
+// tiles are small enough that a handful of them keep every core busy,
+// and big enough that binning doesn't dominate for the triangle scenes
+const int TILE_SIZE = 64;
+
+Image::Image(int width, int height)
+    : width(width), height(height), rgb(width*height*3, 0)
+{
+}
+
+void Image::clear(unsigned char r, unsigned char g, unsigned char b)
+{
+    for(size_t i=0; i<rgb.size(); i+=3) {
+        rgb[i] = r;
+        rgb[i+1] = g;
+        rgb[i+2] = b;
+    }
+}
+
+// --------------------------------------------------------------------------
+// Primitive assembly
+
+// how many lines, triangles or points n vertices make
+static long primitiveCount(int primitive, long n)
+{
+    switch(primitive) {
+        case PRIMITIVE::LINES:      return n/2;
+        case PRIMITIVE::LINE_STRIP: return n >= 2 ? n-1 : 0;
+        case PRIMITIVE::TRIANGLES:  return n/3;
+        case PRIMITIVE::POINTS:     return n;
+    }
+    return 0;
+}
+
+// index of the first vertex of primitive p and how many vertices it has
+static int primitiveVertices(int primitive, long p, long& first)
+{
+    switch(primitive) {
+        case PRIMITIVE::LINES:      first = 2*p; return 2;
+        case PRIMITIVE::LINE_STRIP: first = p;   return 2;
+        case PRIMITIVE::TRIANGLES:  first = 3*p; return 3;
+    }
+    first = p;
+    return 1;
+}
+
+// Everything is rasterized in window coordinates like OpenGL does it:
+// (0, 0) is the bottom left corner and pixel centers sit at +0.5
+struct Target {
+    Image& image;
+    int x0, y0, x1, y1;                     // the tile being drawn, [x0, x1) x [y0, y1)
+
+    Target(Image& image, int x0, int y0, int x1, int y1)
+        : image(image), x0(x0), y0(y0), x1(x1), y1(y1) {}
+
+    void plot(int x, int y, vec3 color)
+    {
+        color = clamp(color, 0.0f, 1.0f);
+        unsigned char* pixel = &image.rgb[((image.height-1-y)*image.width + x)*3];
+        pixel[0] = (unsigned char)(color.r*255.0f + 0.5f);
+        pixel[1] = (unsigned char)(color.g*255.0f + 0.5f);
+        pixel[2] = (unsigned char)(color.b*255.0f + 0.5f);
+    }
+};
+
+// Points are binned already resolved to a pixel and a color: a tile's points are
+// scattered all over the vertex arrays, and chasing them there costs a couple of
+// cache misses per point, far more than drawing them
+struct BinnedPoint {
+    unsigned int pixel;                     // offset of the pixel in Image::rgb
+    unsigned char rgb[4];
+};
+
+// a 1 pixel point covers the pixel whose center is closest to it,
+// and like everything else a point on a pixel boundary lands below/left of it
+static bool binPoint(const Image& image, vec2 a, vec3 color, BinnedPoint& point)
+{
+    int x = (int)ceil(a.x) - 1;
+    int y = (int)ceil(a.y) - 1;
+    if(x < 0 || x >= image.width || y < 0 || y >= image.height)
+        return false;
+
+    color = clamp(color, 0.0f, 1.0f);
+    point.pixel = ((image.height-1-y)*image.width + x)*3;
+    point.rgb[0] = (unsigned char)(color.r*255.0f + 0.5f);
+    point.rgb[1] = (unsigned char)(color.g*255.0f + 0.5f);
+    point.rgb[2] = (unsigned char)(color.b*255.0f + 0.5f);
+    return true;
+}
+
+// GPUs snap vertices to a fixed-point grid, so do the same (1/256 of a pixel);
+// otherwise rounding noise decides which side of a pixel boundary things land on
+static vec2 toWindow(vec2 p, const Image& image)
+{
+    vec2 window((p.x + 1.0f)*0.5f*image.width, (p.y + 1.0f)*0.5f*image.height);
+    return round(window*256.0f)/256.0f;
+}
+
+// steps along the major axis one pixel center at a time, leaving out the last
+// pixel so line strips don't draw their shared vertices twice
+// a line running exactly along a pixel boundary lands on the pixel below/left of it, like it does in OpenGL
+static void drawLine(Target& target, vec2 a, vec2 b, vec3 colorA, vec3 colorB)
+{
+    vec2 d = b - a;
+    bool xMajor = abs(d.x) >= abs(d.y);
+    float length = xMajor ? d.x : d.y;
+    if(length == 0.0f)
+        return;
+
+    float start = xMajor ? a.x : a.y;
+    float end = xMajor ? b.x : b.y;
+    int lo = (int)ceil(std::min(start, end) - 0.5f);
+    int hi = (int)ceil(std::max(start, end) - 0.5f);
+
+    // only walk the part of the line that crosses this tile
+    lo = std::max(lo, xMajor ? target.x0 : target.y0);
+    hi = std::min(hi, xMajor ? target.x1 : target.y1);
+
+    for(int i=lo; i<hi; i++) {
+        float t = (i + 0.5f - start)/length;
+        int j = (int)ceil(xMajor ? a.y + t*d.y : a.x + t*d.x) - 1;
+        int x = xMajor ? i : j;
+        int y = xMajor ? j : i;
+        if(x >= target.x0 && x < target.x1 && y >= target.y0 && y < target.y1)
+            target.plot(x, y, colorA*(1.0f-t) + colorB*t);
+    }
+}
+
+// > 0 when p is to the left of the edge a->b
+static float edge(vec2 a, vec2 b, vec2 p)
+{
+    return (b.x - a.x)*(p.y - a.y) - (b.y - a.y)*(p.x - a.x);
+}
+
+// pixels exactly on an edge belong to the triangle on its top or left side,
+// so triangles sharing an edge don't both draw it
+static bool topLeft(vec2 a, vec2 b)
+{
+    return b.y < a.y || (b.y == a.y && b.x < a.x);
+}
+
+static void drawTriangle(Target& target, vec2 a, vec2 b, vec2 c, vec3 colorA, vec3 colorB, vec3 colorC)
+{
+    float area = edge(a, b, c);
+    if(area == 0.0f)
+        return;
+    // nothing gets culled, so wind everything counter-clockwise
+    if(area < 0.0f) {
+        swap(b, c);
+        swap(colorB, colorC);
+        area = -area;
+    }
+
+    int xMin = std::max(target.x0, (int)floor(std::min(a.x, std::min(b.x, c.x))));
+    int xMax = std::min(target.x1, (int)ceil(std::max(a.x, std::max(b.x, c.x))) + 1);
+    int yMin = std::max(target.y0, (int)floor(std::min(a.y, std::min(b.y, c.y))));
+    int yMax = std::min(target.y1, (int)ceil(std::max(a.y, std::max(b.y, c.y))) + 1);
+
+    bool topLeftA = topLeft(b, c);
+    bool topLeftB = topLeft(c, a);
+    bool topLeftC = topLeft(a, b);
+
+    for(int y=yMin; y<yMax; y++) {
+        for(int x=xMin; x<xMax; x++) {
+            vec2 p(x + 0.5f, y + 0.5f);
+            float wa = edge(b, c, p);
+            float wb = edge(c, a, p);
+            float wc = edge(a, b, p);
+            if(wa < 0.0f || wb < 0.0f || wc < 0.0f)
+                continue;
+            if((wa == 0.0f && !topLeftA) || (wb == 0.0f && !topLeftB) || (wc == 0.0f && !topLeftC))
+                continue;
+            target.plot(x, y, (colorA*wa + colorB*wb + colorC*wc)/area);
+        }
+    }
+}
+
+// --------------------------------------------------------------------------
+// Tile binning
+
+void rasterize(Image& image, int primitive, const vector<vec2>& points, const vector<vec3>& colors, int threads)
+{
+    long count = primitiveCount(primitive, std::min(points.size(), colors.size()));
+    if(count == 0 || image.width <= 0 || image.height <= 0)
+        return;
+
+    if(threads <= 0)
+        threads = std::max(1u, thread::hardware_concurrency());
+    threads = (int)std::min((long)threads, count);
+
+    int columns = (image.width + TILE_SIZE - 1)/TILE_SIZE;
+    int rows = (image.height + TILE_SIZE - 1)/TILE_SIZE;
+    int tiles = columns*rows;
+
+    // vertices in window coordinates, shared by the binning and drawing passes
+    vector<vec2> window(points.size());
+
+    // every thread bins a contiguous run of primitives into its own lists, so
+    // reading the lists back thread by thread keeps the submission order
+    // (the lists are filled like a counting sort: count per tile, then place)
+    vector< vector<unsigned int> > binStart(threads, vector<unsigned int>(tiles + 1, 0));
+    vector< vector<unsigned int> > bins(threads);
+    vector< vector<BinnedPoint> > pointBins(threads);
+    bool pointPrimitives = primitive == PRIMITIVE::POINTS;
+
+    vector<thread> pool;
+    for(int t=0; t<threads; t++) {
+        pool.push_back(thread([&, t]() {
+            size_t begin = points.size()*t/threads;
+            size_t end = points.size()*(t+1)/threads;
+            for(size_t v=begin; v<end; v++)
+                window[v] = toWindow(points[v], image);
+        }));
+    }
+    for(int t=0; t<threads; t++)
+        pool[t].join();
+    pool.clear();
+
+    // tiles touched by primitive p, returns false if it's entirely off screen
+    auto tileRange = [&](long p, int& tx0, int& ty0, int& tx1, int& ty1) {
+        long first;
+        int n = primitiveVertices(primitive, p, first);
+        vec2 lo = window[first];
+        vec2 hi = window[first];
+        for(int i=1; i<n; i++) {
+            lo = min(lo, window[first+i]);
+            hi = max(hi, window[first+i]);
+        }
+
+        // pad by a pixel, things on a tile's edge can land on the pixel before it
+        if(hi.x < -1.0f || hi.y < -1.0f)
+            return false;
+        tx0 = std::max(0, (int)floor(lo.x - 1.0f)/TILE_SIZE);
+        ty0 = std::max(0, (int)floor(lo.y - 1.0f)/TILE_SIZE);
+        tx1 = std::min(columns-1, (int)floor(hi.x + 1.0f)/TILE_SIZE);
+        ty1 = std::min(rows-1, (int)floor(hi.y + 1.0f)/TILE_SIZE);
+        return true;
+    };
+
+    // a point only ever touches the one tile its pixel is in
+    auto pointTile = [&](const BinnedPoint& point) {
+        int x = point.pixel/3 % image.width;
+        int y = image.height-1 - point.pixel/3/image.width;
+        return (y/TILE_SIZE)*columns + x/TILE_SIZE;
+    };
+
+    for(int t=0; t<threads; t++) {
+        pool.push_back(thread([&, t]() {
+            vector<unsigned int>& start = binStart[t];
+            long begin = count*t/threads;
+            long end = count*(t+1)/threads;
+            int tx0, ty0, tx1, ty1;
+            BinnedPoint point;
+
+            for(long p=begin; p<end; p++) {
+                if(pointPrimitives) {
+                    if(binPoint(image, window[p], colors[p], point))
+                        start[pointTile(point) + 1]++;
+                    continue;
+                }
+                if(!tileRange(p, tx0, ty0, tx1, ty1))
+                    continue;
+                for(int ty=ty0; ty<=ty1; ty++) {
+                    for(int tx=tx0; tx<=tx1; tx++)
+                        start[ty*columns + tx + 1]++;
+                }
+            }
+            for(int tile=0; tile<tiles; tile++)
+                start[tile+1] += start[tile];
+
+            vector<unsigned int> next(start.begin(), start.end() - 1);
+            if(pointPrimitives)
+                pointBins[t].resize(start[tiles]);
+            else
+                bins[t].resize(start[tiles]);
+
+            for(long p=begin; p<end; p++) {
+                if(pointPrimitives) {
+                    if(binPoint(image, window[p], colors[p], point))
+                        pointBins[t][next[pointTile(point)]++] = point;
+                    continue;
+                }
+                if(!tileRange(p, tx0, ty0, tx1, ty1))
+                    continue;
+                for(int ty=ty0; ty<=ty1; ty++) {
+                    for(int tx=tx0; tx<=tx1; tx++)
+                        bins[t][next[ty*columns + tx]++] = (unsigned int)p;
+                }
+            }
+        }));
+    }
+    for(int t=0; t<threads; t++)
+        pool[t].join();
+    pool.clear();
+
+    // tiles don't overlap, so threads can take them in any order without locking
+    atomic<int> nextTile(0);
+    for(int t=0; t<threads; t++) {
+        pool.push_back(thread([&]() {
+            for(int tile=nextTile++; tile<tiles; tile=nextTile++) {
+                int tx = tile%columns;
+                int ty = tile/columns;
+                Target target(image, tx*TILE_SIZE, ty*TILE_SIZE,
+                              std::min(image.width, (tx+1)*TILE_SIZE), std::min(image.height, (ty+1)*TILE_SIZE));
+
+                for(int b=0; b<threads; b++) {
+                    for(unsigned int i=binStart[b][tile]; pointPrimitives && i<binStart[b][tile+1]; i++) {
+                        const BinnedPoint& point = pointBins[b][i];
+                        image.rgb[point.pixel] = point.rgb[0];
+                        image.rgb[point.pixel+1] = point.rgb[1];
+                        image.rgb[point.pixel+2] = point.rgb[2];
+                    }
+                    for(unsigned int i=binStart[b][tile]; !pointPrimitives && i<binStart[b][tile+1]; i++) {
+                        long first;
+                        int n = primitiveVertices(primitive, bins[b][i], first);
+                        if(n == 2)
+                            drawLine(target, window[first], window[first+1], colors[first], colors[first+1]);
+                        else
+                            drawTriangle(target, window[first], window[first+1], window[first+2],
+                                         colors[first], colors[first+1], colors[first+2]);
+                    }
+                }
+            }
+        }));
+    }
+    for(int t=0; t<threads; t++)
+        pool[t].join();
+}
+
+// --------------------------------------------------------------------------
+// Image output
+
+static void writeBigEndian(string& out, unsigned int value)
+{
+    out += (char)(value >> 24);
+    out += (char)(value >> 16);
+    out += (char)(value >> 8);
+    out += (char)value;
+}
+
+static unsigned int crc32(const string& data, size_t begin)
+{
+    static unsigned int table[256];
+    if(table[1] == 0) {
+        for(unsigned int n=0; n<256; n++) {
+            unsigned int c = n;
+            for(int k=0; k<8; k++)
+                c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+            table[n] = c;
+        }
+    }
+
+    unsigned int crc = 0xffffffffu;
+    for(size_t i=begin; i<data.size(); i++)
+        crc = table[(crc ^ (unsigned char)data[i]) & 0xff] ^ (crc >> 8);
+    return crc ^ 0xffffffffu;
+}
+
+static void writeChunk(string& png, const char* type, const string& data)
+{
+    writeBigEndian(png, data.size());
+    size_t begin = png.size();
+    png += type;
+    png += data;
+    writeBigEndian(png, crc32(png, begin));
+}
+
+// PNG without a compressor: the image goes into "stored" deflate blocks,
+// which every PNG reader understands and keeps us free of zlib
+static string encodePNG(const Image& image)
+{
+    string raw;
+    raw.reserve((image.width*3 + 1)*image.height);
+    for(int y=0; y<image.height; y++) {
+        raw += (char)0;                     // no filter on this row
+        raw.append((const char*)&image.rgb[y*image.width*3], image.width*3);
+    }
+
+    string zlib;
+    zlib += (char)0x78;
+    zlib += (char)0x01;
+    for(size_t begin=0; begin<raw.size() || begin==0; begin+=65535) {
+        size_t length = std::min((size_t)65535, raw.size() - begin);
+        bool last = begin + length >= raw.size();
+        zlib += (char)(last ? 1 : 0);
+        zlib += (char)(length & 0xff);
+        zlib += (char)(length >> 8);
+        zlib += (char)(~length & 0xff);
+        zlib += (char)((~length >> 8) & 0xff);
+        zlib.append(raw, begin, length);
+        if(last)
+            break;
+    }
+    unsigned int a = 1;
+    unsigned int b = 0;
+    for(size_t i=0; i<raw.size(); i++) {
+        a = (a + (unsigned char)raw[i]) % 65521;
+        b = (b + a) % 65521;
+    }
+    writeBigEndian(zlib, (b << 16) | a);
+
+    string header;
+    writeBigEndian(header, image.width);
+    writeBigEndian(header, image.height);
+    header += (char)8;                      // bits per channel
+    header += (char)2;                      // RGB
+    header += (char)0;
+    header += (char)0;
+    header += (char)0;
+
+    string png("\x89PNG\r\n\x1a\n", 8);
+    writeChunk(png, "IHDR", header);
+    writeChunk(png, "IDAT", zlib);
+    writeChunk(png, "IEND", string());
+    return png;
+}
+
+bool writeImage(const Image& image, const string& filename)
+{
+    ofstream output(filename.c_str(), ios::binary);
+    if(!output)
+        return false;
+
+    bool png = filename.size() >= 4 && filename.compare(filename.size()-4, 4, ".png") == 0;
+    if(png) {
+        string data = encodePNG(image);
+        output.write(data.data(), data.size());
+    }
+    else {
+        output << "P6\n" << image.width << " " << image.height << "\n255\n";
+        output.write((const char*)image.rgb.data(), image.rgb.size());
+    }
+
+    return (bool)output;
+}
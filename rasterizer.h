@@ -0,0 +1,40 @@
+// ==========================================================================
+// Headless CPU rasterizer
+//
+// Draws the same points/colors the scenes hand to OpenGL into an in-memory
+// image, so every scene can be rendered on machines without a GPU or a
+// display. The image is split into tiles, primitives are binned to the tiles
+// they touch, and tiles are rasterized in parallel. Within a tile primitives
+// are drawn in submission order, so overlaps come out the same way OpenGL
+// draws them.
+//
+// Modifications and additional functionality by Cameron Hardy (ID 10084560)
+// ==========================================================================
+
+#ifndef RASTERIZER_H
+#define RASTERIZER_H
+
+#include <string>
+#include <vector>
+#include "glm/glm.hpp"
+#include "generators.h"
+
+// 8-bit RGB image, row 0 is the top of the picture
+struct Image {
+    int width;
+    int height;
+    std::vector<unsigned char> rgb;
+
+    Image(int width, int height);
+    void clear(unsigned char r, unsigned char g, unsigned char b);
+};
+
+// draws the vertices as the given primitive type over whatever is already in the image
+// threads <= 0 uses one thread per core
+void rasterize(Image& image, int primitive, const std::vector<glm::vec2>& points,
+               const std::vector<glm::vec3>& colors, int threads = 0);
+
+// writes a binary PPM (P6) or, if the filename ends in .png, an uncompressed PNG
+bool writeImage(const Image& image, const std::string& filename);
+
+#endif
@@ -0,0 +1,172 @@
+// ==========================================================================
+// Work-stealing tile pool
+//
+// Modifications and additional functionality by Cameron Hardy (ID 10084560)
+// ==========================================================================
+
+#include "tilepool.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+using namespace std;
+
+// one per thread, the tiles [next, end) it still has to do. The owner takes
+// from the front, thieves take the back half, so what's left is always one
+// run of tiles and stealing it is just moving the ends
+struct TileRange {
+    mutex lock;
+    int next;
+    int end;
+
+    TileRange() : next(0), end(0) {}
+};
+
+// the threads stay up between calls and wait here for the next job. Worker w
+// does the job as thread w + 1, the calling thread is thread 0
+struct TilePool {
+    mutex calls;                            // held by whoever's job is running
+    mutex lock;                             // guards the rest
+    condition_variable wake;                // a new job is up
+    condition_variable finished;            // the last worker finished it
+    int workers;
+    long generation;                        // goes up by one every job
+    TileRange* ranges;                      // one per thread, 0 to capacity
+    int capacity;
+
+    // the job, while there's one
+    const function<void(int, int)>* task;
+    int threads;
+    int busy;                               // workers still on it
+
+    TilePool() : workers(0), generation(0), ranges(0), capacity(0), task(0), threads(0), busy(0) {}
+};
+
+// never destroyed, since the workers wait on it until the program exits
+static TilePool& pool = *new TilePool;
+
+// set on the workers, and on the caller while it does its share, so a task
+// that runs tiles of its own doesn't wait on the job it's part of
+static thread_local bool inJob = false;
+
+int tileThreads(int threads)
+{
+    if(threads <= 0)
+        threads = std::max(1u, thread::hardware_concurrency());
+    return threads;
+}
+
+// next tile for thread t, or -1 once every range is empty
+static int takeTile(int t)
+{
+    TileRange& own = pool.ranges[t];
+    {
+        lock_guard<mutex> guard(own.lock);
+        if(own.next < own.end)
+            return own.next++;
+    }
+
+    // out of work, so steal the back half of the first range that has some.
+    // Starting at the next thread spreads the thieves out over the victims
+    for(int i=1; i<pool.threads; i++) {
+        TileRange& victim = pool.ranges[(t + i)%pool.threads];
+        int first, end;
+        {
+            lock_guard<mutex> guard(victim.lock);
+            end = victim.end;
+            first = victim.end - (victim.end - victim.next + 1)/2;
+            victim.end = first;
+        }
+        if(first == end)
+            continue;
+
+        // run the first stolen tile now and keep the rest for later (someone
+        // else may come and steal them back in the meantime). Nobody steals
+        // from an empty range, so own is still empty
+        lock_guard<mutex> guard(own.lock);
+        own.next = first + 1;
+        own.end = end;
+        return first;
+    }
+    return -1;
+}
+
+static void runShare(int t)
+{
+    for(int tile=takeTile(t); tile >= 0; tile=takeTile(t))
+        (*pool.task)(tile, t);
+}
+
+static void workerLoop(int w, long seen)
+{
+    inJob = true;
+    unique_lock<mutex> guard(pool.lock);
+    for(;;) {
+        pool.wake.wait(guard, [&] { return pool.generation != seen; });
+        seen = pool.generation;
+        if(w + 1 >= pool.threads)
+            continue;
+
+        guard.unlock();
+        runShare(w + 1);
+        guard.lock();
+        if(--pool.busy == 0)
+            pool.finished.notify_one();
+    }
+}
+
+void runThreadTiles(int tiles, int threads, const function<void(int, int)>& task)
+{
+    if(tiles <= 0)
+        return;
+    threads = std::min(tileThreads(threads), tiles);
+
+    // nothing to balance, or already inside a job
+    if(threads == 1 || inJob) {
+        for(int tile=0; tile<tiles; tile++)
+            task(tile, 0);
+        return;
+    }
+
+    lock_guard<mutex> call(pool.calls);
+    {
+        lock_guard<mutex> guard(pool.lock);
+        // only the caller touches the ranges between jobs, so they can be
+        // swapped for a bigger set here. The old ones are dropped with the
+        // workers idle, and there are only ever a few of them
+        if(threads > pool.capacity) {
+            delete[] pool.ranges;
+            pool.ranges = new TileRange[threads];
+            pool.capacity = threads;
+        }
+        // a new worker starts out having seen every job so far
+        for(; pool.workers < threads - 1; pool.workers++)
+            thread(workerLoop, pool.workers, pool.generation).detach();
+
+        for(int t=0; t<threads; t++) {
+            pool.ranges[t].next = (long)tiles*t/threads;
+            pool.ranges[t].end = (long)tiles*(t+1)/threads;
+        }
+        pool.task = &task;
+        pool.threads = threads;
+        pool.busy = threads - 1;
+        pool.generation++;
+    }
+    pool.wake.notify_all();
+
+    // the calling thread does a share of the work too
+    inJob = true;
+    runShare(0);
+    inJob = false;
+
+    unique_lock<mutex> guard(pool.lock);
+    pool.finished.wait(guard, [&] { return pool.busy == 0; });
+    pool.task = 0;
+}
+
+void runTiles(int tiles, int threads, const function<void(int)>& task)
+{
+    runThreadTiles(tiles, threads, [&](int tile, int) { task(tile); });
+}
@@ -0,0 +1,31 @@
+// ==========================================================================
+// Work-stealing tile pool
+//
+// Splits a job into numbered tiles and runs them across a set of threads.
+// Every thread starts with its own contiguous run of tiles and works through
+// it from the front; a thread that runs out steals the back half of what's
+// left of someone else's. That keeps the threads busy even when some tiles
+// take far longer than others, like the inside of the Mandelbrot set against
+// the outside. The threads are started the first time they're needed and
+// then wait for the next job, so a call doesn't pay for starting any.
+//
+// Modifications and additional functionality by Cameron Hardy (ID 10084560)
+// ==========================================================================
+
+#ifndef TILEPOOL_H
+#define TILEPOOL_H
+
+#include <functional>
+
+// calls task(tile) once for every tile in [0, tiles), from `threads` threads
+// (<= 0 uses one per core). Returns when they're all done. One job runs at a
+// time, and a task that calls it again runs its tiles on its own thread
+void runTiles(int tiles, int threads, const std::function<void(int)>& task);
+// same thing, also telling the task which thread it's on (0 up to tileThreads(threads)),
+// so it can keep scratch space per thread instead of allocating it for every tile
+void runThreadTiles(int tiles, int threads, const std::function<void(int tile, int thread)>& task);
+
+// how many threads runTiles uses for a given request
+int tileThreads(int threads);
+
+#endif
@@ -0,0 +1,271 @@
+// ==========================================================================
+// Tile store
+//
+// Modifications and additional functionality by Cameron Hardy (ID 10084560)
+// ==========================================================================
+
+#include "tilestore.h"
+
+#include <atomic>
+#include <cstring>
+#include <mutex>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+const int STORE_TILE = 64;                  // points each way in a record
+const int STORE_PROBES = 8;                 // slots a key can be in, from the one it hashes to on
+const int STORE_PYRAMID = 8;                // coarser lattices every point is also stored on
+const int STORE_UNKNOWN = -1;
+
+struct StoreHeader {
+    char magic[8];
+    int recordBytes;                        // so a file from a different layout gets started over
+    int tile;
+    long long records;
+};
+
+const char STORE_MAGIC[8] = {'E', 'S', 'C', 'T', 'I', 'L', 'E', '1'};
+const size_t STORE_HEADER_BYTES = 4096;     // records start a page in
+
+struct StoreRecord {
+    unsigned long long hash;                // 0 for a slot nobody's used
+    TileLattice lattice;
+    long long tileX;                        // which block of the lattice it is
+    long long tileY;
+    int levels[STORE_TILE*STORE_TILE];      // row by row, STORE_UNKNOWN for points not stored yet
+};
+
+static mutex storeLock;
+static unsigned char* storeMemory = 0;
+static size_t storeBytes = 0;
+static StoreRecord* storeRecords = 0;
+static long long storeRecordCount = 0;
+static atomic<long long> storeHits(0);
+
+bool openTileStore(const char* path, double megabytes)
+{
+    closeTileStore();
+
+    long long records = (long long)(megabytes*1024*1024 - STORE_HEADER_BYTES)/(long long)sizeof(StoreRecord);
+    if(records < STORE_PROBES)
+        return false;
+    size_t bytes = STORE_HEADER_BYTES + (size_t)records*sizeof(StoreRecord);
+
+    int file = open(path, O_RDWR | O_CREAT, 0644);
+    if(file < 0)
+        return false;
+
+    // an existing store is only kept if it's laid out the way this one would be
+    StoreHeader header;
+    struct stat info;
+    bool keep = fstat(file, &info) == 0 && (size_t)info.st_size == bytes &&
+                pread(file, &header, sizeof(header), 0) == (ssize_t)sizeof(header) &&
+                memcmp(header.magic, STORE_MAGIC, sizeof(STORE_MAGIC)) == 0 &&
+                header.recordBytes == (int)sizeof(StoreRecord) && header.tile == STORE_TILE && header.records == records;
+    // truncating to 0 first leaves every slot zeroed, so empty
+    if(!keep && (ftruncate(file, 0) != 0 || ftruncate(file, bytes) != 0)) {
+        close(file);
+        return false;
+    }
+
+    void* memory = mmap(0, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+    close(file);
+    if(memory == MAP_FAILED)
+        return false;
+
+    lock_guard<mutex> guard(storeLock);
+    storeMemory = (unsigned char*)memory;
+    storeBytes = bytes;
+    storeRecords = (StoreRecord*)(storeMemory + STORE_HEADER_BYTES);
+    storeRecordCount = records;
+    if(!keep) {
+        memcpy(header.magic, STORE_MAGIC, sizeof(STORE_MAGIC));
+        header.recordBytes = (int)sizeof(StoreRecord);
+        header.tile = STORE_TILE;
+        header.records = records;
+        memcpy(storeMemory, &header, sizeof(header));
+    }
+    return true;
+}
+
+void closeTileStore()
+{
+    lock_guard<mutex> guard(storeLock);
+    if(!storeMemory)
+        return;
+    msync(storeMemory, storeBytes, MS_SYNC);
+    munmap(storeMemory, storeBytes);
+    storeMemory = 0;
+    storeRecords = 0;
+    storeRecordCount = 0;
+}
+
+bool tileStoreOpen()
+{
+    return storeMemory != 0;
+}
+
+long long tileStoreHits()
+{
+    return storeHits.load(memory_order_relaxed);
+}
+
+// --------------------------------------------------------------------------
+// Records
+
+static void hashBytes(unsigned long long& hash, const void* data, size_t bytes)
+{
+    const unsigned char* p = (const unsigned char*)data;
+    for(size_t k=0; k<bytes; k++) {
+        hash ^= p[k];
+        hash *= 1099511628211ull;
+    }
+}
+
+// FNV-1a of the key, never 0 since that marks an empty slot
+static unsigned long long hashKey(const TileLattice& lattice, long long tileX, long long tileY)
+{
+    unsigned long long hash = 14695981039346656037ull;
+    hashBytes(hash, &lattice.formula, sizeof(lattice.formula));
+    hashBytes(hash, &lattice.level, sizeof(lattice.level));
+    hashBytes(hash, &lattice.juliaX, sizeof(lattice.juliaX));
+    hashBytes(hash, &lattice.juliaY, sizeof(lattice.juliaY));
+    hashBytes(hash, &lattice.unitX, sizeof(lattice.unitX));
+    hashBytes(hash, &lattice.unitY, sizeof(lattice.unitY));
+    hashBytes(hash, lattice.x.limb, sizeof(lattice.x.limb));
+    hashBytes(hash, lattice.y.limb, sizeof(lattice.y.limb));
+    hashBytes(hash, &tileX, sizeof(tileX));
+    hashBytes(hash, &tileY, sizeof(tileY));
+    return hash ? hash : 1;
+}
+
+static bool sameKey(const StoreRecord& record, unsigned long long hash, const TileLattice& lattice, long long tileX, long long tileY)
+{
+    const TileLattice& a = record.lattice;
+    return record.hash == hash && record.tileX == tileX && record.tileY == tileY &&
+           a.formula == lattice.formula && a.level == lattice.level &&
+           a.juliaX == lattice.juliaX && a.juliaY == lattice.juliaY &&
+           a.unitX == lattice.unitX && a.unitY == lattice.unitY &&
+           deepEqual(a.x, lattice.x) && deepEqual(a.y, lattice.y);
+}
+
+// the record for a block, or null if it isn't stored. With `claim` a block
+// that isn't stored gets a record, the first empty one it could be in or else
+// the one it hashes to, whatever was in it before
+static StoreRecord* findRecord(const TileLattice& lattice, long long tileX, long long tileY, bool claim)
+{
+    unsigned long long hash = hashKey(lattice, tileX, tileY);
+    long long home = (long long)(hash % (unsigned long long)storeRecordCount);
+    StoreRecord* empty = 0;
+    for(int k=0; k<STORE_PROBES; k++) {
+        StoreRecord& record = storeRecords[(home + k) % storeRecordCount];
+        if(sameKey(record, hash, lattice, tileX, tileY))
+            return &record;
+        if(!record.hash && !empty)
+            empty = &record;
+    }
+    if(!claim)
+        return 0;
+
+    StoreRecord* record = empty ? empty : &storeRecords[home];
+    record->lattice = lattice;
+    record->tileX = tileX;
+    record->tileY = tileY;
+    for(int k=0; k<STORE_TILE*STORE_TILE; k++)
+        record->levels[k] = STORE_UNKNOWN;
+    record->hash = hash;
+    return record;
+}
+
+// which block a point is in, rounding down for points left of or below the origin
+static long long blockOf(long long p)
+{
+    return p >= 0 ? p/STORE_TILE : -((-p + STORE_TILE - 1)/STORE_TILE);
+}
+
+// --------------------------------------------------------------------------
+// Rows
+
+int readTileStore(const TileLattice& lattice, long long p, long long q, int step, int count, int* levels)
+{
+    for(int k=0; k<count; k++)
+        levels[k] = STORE_UNKNOWN;
+
+    lock_guard<mutex> guard(storeLock);
+    if(!storeMemory)
+        return 0;
+
+    long long tileY = blockOf(q);
+    int row = (int)(q - tileY*STORE_TILE);
+    int found = 0;
+    // a row only crosses a few blocks, so look each one up once
+    long long tileX = 0;
+    StoreRecord* record = 0;
+    for(int k=0; k<count; k++) {
+        long long point = p + (long long)k*step;
+        if(!record || blockOf(point) != tileX) {
+            tileX = blockOf(point);
+            record = findRecord(lattice, tileX, tileY, false);
+            if(!record) {
+                // skip to the next block
+                long long next = (tileX + 1)*STORE_TILE;
+                int skip = (int)((next - point + step - 1)/step) - 1;
+                k += skip;
+                continue;
+            }
+        }
+        int stored = record->levels[row*STORE_TILE + (int)(point - tileX*STORE_TILE)];
+        if(stored != STORE_UNKNOWN) {
+            levels[k] = stored;
+            found++;
+        }
+    }
+    storeHits.fetch_add(found, memory_order_relaxed);
+    return found;
+}
+
+// writes levels[k*stride] at point (p + k*step, q), and the even points into the lattice above
+static void writeRow(TileLattice lattice, long long p, long long q, int step, int count, const int* levels, int stride,
+                     int depth)
+{
+    long long tileY = blockOf(q);
+    int row = (int)(q - tileY*STORE_TILE);
+    long long tileX = 0;
+    StoreRecord* record = 0;
+    for(int k=0; k<count; k++) {
+        int level = levels[k*stride];
+        if(level < 0)
+            continue;
+        long long point = p + (long long)k*step;
+        if(!record || blockOf(point) != tileX) {
+            tileX = blockOf(point);
+            record = findRecord(lattice, tileX, tileY, true);
+        }
+        record->levels[row*STORE_TILE + (int)(point - tileX*STORE_TILE)] = level;
+    }
+
+    // point 2p of a lattice is point p of the one twice as coarse
+    if(depth >= STORE_PYRAMID || (q & 1))
+        return;
+    int first = (p & 1) ? 1 : 0;
+    if(step % 2 == 0 && first)
+        return;                             // every point is odd
+    lattice.unitX *= 2.0;
+    lattice.unitY *= 2.0;
+    if(step % 2 == 0)
+        writeRow(lattice, p/2, q/2, step/2, count, levels, stride, depth + 1);
+    else if(count > first)
+        writeRow(lattice, (p + first*step)/2, q/2, step, (count - first + 1)/2, levels + first*stride, 2*stride, depth + 1);
+}
+
+void writeTileStore(const TileLattice& lattice, long long p, long long q, int step, int count, const int* levels)
+{
+    lock_guard<mutex> guard(storeLock);
+    if(!storeMemory)
+        return;
+    writeRow(lattice, p, q, step, count, levels, 1, 0);
+}
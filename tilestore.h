@@ -0,0 +1,57 @@
+// ==========================================================================
+// Tile store
+//
+// Keeps how many iterations every texel of the Mandelbrot and Julia sets had
+// left in a file, so a view that's been made before (in this run or any
+// earlier one) comes straight back without iterating anything. The file is a
+// fixed number of fixed-size records, memory mapped, and used as a hash table:
+// each record is a 64x64 block of one lattice's points, keyed by which set it
+// is, c, the level, the lattice (how far apart its points are and where it
+// starts) and which block of it.
+//
+// The lattices make a quadtree. Every other point of a lattice each way is a
+// point of the lattice twice as coarse over the same origin (the view zoomed
+// out 2x), so whatever's stored for one lattice is also stored for the
+// coarser ones above it, and a zoomed out view can come from what was
+// iterated for the zoomed in ones. When the file is full, new blocks take
+// over old ones.
+//
+// Modifications and additional functionality by Cameron Hardy (ID 10084560)
+// ==========================================================================
+
+#ifndef TILESTORE_H
+#define TILESTORE_H
+
+#include "deepzoom.h"
+
+// a lattice the way the images see it: point (p, q) of it is at
+// (unitX*p + x, unitY*q + y) past the corner the formula starts at
+struct TileLattice {
+    int formula;                            // ESCAPE formula
+    int level;
+    double juliaX;                          // c, for the Julia set
+    double juliaY;
+    double unitX;                           // how far apart the points are
+    double unitY;
+    DeepFixed x;                            // and where point (0, 0) is
+    DeepFixed y;
+};
+
+// maps the store at path, making it (or starting it over, if it's from some
+// other version) `megabytes` big; false if it couldn't
+bool openTileStore(const char* path, double megabytes);
+// writes it all back to the file and unmaps it
+void closeTileStore();
+bool tileStoreOpen();
+
+// reads points (p + k*step, q) of a lattice for every k < count into levels,
+// -1 for the ones the store doesn't have. Returns how many it had
+int readTileStore(const TileLattice& lattice, long long p, long long q, int step, int count, int* levels);
+// stores the same points (leaving out negative levels), and every one of them
+// that's on a coarser lattice of the pyramid there too
+void writeTileStore(const TileLattice& lattice, long long p, long long q, int step, int count, const int* levels);
+
+// how many points the store has had, over every readTileStore call since the program started
+long long tileStoreHits();
+
+#endif